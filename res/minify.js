@@ -0,0 +1,114 @@
+// Regenerates www/app.js, the script the controller page loads, from www/src.js:
+//
+//   node res/minify.js
+//
+// Comments and indentation are dropped and lines are joined wherever that cannot
+// change how automatic semicolon insertion reads them. Names are kept, so app.js
+// stays debuggable and a diff against src.js is easy to follow. Run it after
+// every change to src.js, app.js is never edited by hand.
+
+"use strict";
+
+const fs = require("fs");
+const path = require("path");
+
+const WWW = path.join(__dirname, "www");
+
+const isWord = (c) => /[A-Za-z0-9_$]/.test(c);
+
+// Index just past the string, template literal or block starting at i
+const skipQuoted = (src, i) => {
+  const quote = src[i++];
+  while (i < src.length && src[i] !== quote) {
+    if (src[i] === "\\") {
+      i += 2;
+    } else if (quote === "`" && src.startsWith("${", i)) {
+      i = skipCode(src, i + 2, "}");
+    } else {
+      i++;
+    }
+  }
+  return i + 1;
+};
+
+// Index just past the closing character of code that started before i
+const skipCode = (src, i, close) => {
+  var depth = 0;
+  while (i < src.length) {
+    const c = src[i];
+    if (c === '"' || c === "'" || c === "`") {
+      i = skipQuoted(src, i);
+      continue;
+    }
+    if (c === "{") {
+      depth++;
+    } else if (c === close && depth-- === 0) {
+      return i + 1;
+    }
+    i++;
+  }
+  return i;
+};
+
+const tokenize = (src) => {
+  const tokens = [];
+  var newline = false;
+  var space = false;
+  var i = 0;
+  while (i < src.length) {
+    const c = src[i];
+    var end = i + 1;
+    if (c === "\n") {
+      newline = true;
+      i++;
+      continue;
+    } else if (/\s/.test(c)) {
+      space = true;
+      i++;
+      continue;
+    } else if (src.startsWith("//", i)) {
+      end = src.indexOf("\n", i);
+      i = end < 0 ? src.length : end;
+      continue;
+    } else if (src.startsWith("/*", i)) {
+      i = src.indexOf("*/", i) + 2;
+      continue;
+    } else if (c === '"' || c === "'" || c === "`") {
+      end = skipQuoted(src, i);
+    } else if (isWord(c)) {
+      while (end < src.length && isWord(src[end])) {
+        end++;
+      }
+    }
+    // src.js has no regular expression literals, a / is always division
+    tokens.push({ text: src.substring(i, end), newline: newline, space: space || newline });
+    newline = false;
+    space = false;
+    i = end;
+  }
+  return tokens;
+};
+
+// A line break between these cannot be where a statement ends
+const joinsLines = (prev, next) => ";{,([=:?&|*<>!".includes(prev.slice(-1)) || ")]},;.?:".includes(next[0]);
+
+const minify = (src) => {
+  var out = "";
+  var prev = "";
+  for (const token of tokenize(src)) {
+    if (prev && token.newline && !joinsLines(prev, token.text)) {
+      out += "\n";
+    } else if (isWord(prev.slice(-1)) && isWord(token.text[0])) {
+      out += " ";
+    } else if (token.space && "+-".includes(token.text[0]) && prev.slice(-1) === token.text[0]) {
+      out += " ";
+    }
+    out += token.text;
+    prev = token.text;
+  }
+  return out;
+};
+
+// latin1 passes the bytes of src.js through unchanged, whatever its encoding
+const src = fs.readFileSync(path.join(WWW, "src.js"), "latin1");
+fs.writeFileSync(path.join(WWW, "app.js"), minify(src.replace(/\r\n/g, "\n")), "latin1");
@@ -1 +1,19 @@
-const throttle=(e,t)=>{var a=!0,s=null;return function n(){var o=this;a?(a=!1,setTimeout(function(){a=!0,s&&n.apply(o)},t),s?(e.apply(this,s),s=null):e.apply(this,arguments)):s=arguments}};var keys=document.getElementsByClassName("key"),touchKeys=[],bottomKeys=touchKeys;const compileKey=e=>{let t=e.previousElementSibling,a=e.nextElementSibling;return{top:e.offsetTop,bottom:e.offsetTop+e.offsetHeight,left:e.offsetLeft,right:e.offsetLeft+e.offsetWidth,kflag:parseInt(e.dataset.kflag)+(parseInt(e.dataset.air)?32:0),prevKeyRef:t,nextKeyRef:a,ref:e}},isInside=(e,t,a)=>a.left<=e&&e<a.right&&a.top<=t&&t<a.bottom,compileKeys=()=>{keys=document.getElementsByClassName("key"),touchKeys=[];for(var e,t=0;t<keys.length;t++){let a=compileKey(keys[t]);touchKeys.push(a)}},getKey=(e,t)=>{for(var a=0;a<touchKeys.length;a++)if(isInside(e,t,touchKeys[a]))return touchKeys[a];return null};var lastState=[0,0,0,0,];function updateTouches(e){try{e.preventDefault();var t=[0,0,0,0,];throttledRequestFullscreen();for(var a=0;a<e.touches.length;a++){let s=e.touches[a],n=s.clientX,o=s.clientY,r=getKey(n,o);r&&setKey(t,r.kflag)}for(var a=0;a<touchKeys.length;a++){let l=touchKeys[a],c=l.kflag;t[c]!==lastState[c]&&(t[c]?l.ref.setAttribute("data-active",""):l.ref.removeAttribute("data-active"))}t!==lastState&&throttledSendKeys(t),lastState=t}catch(u){alert(u)}}const throttledUpdateTouches=throttle(updateTouches,10),setKey=(e,t)=>{var a=t;e[a]&&a++,e[a]=1},sendKeys=e=>{wsConnected&&ws.send("b"+e.join(""))},throttledSendKeys=throttle(sendKeys,10);var ws=null,wsTimeout=0,wsConnected=!1;const wsConnect=()=>{(ws=new WebSocket("ws://"+location.host+"/ws")).binaryType="arraybuffer",ws.onopen=()=>{ws.send("alive?")},ws.onmessage=e=>{e.data.byteLength?updateLed(e.data):"alive"==e.data&&(wsTimeout=0,wsConnected=!0)}},wsWatch=()=>{if(wsTimeout++>2){wsTimeout=0,ws.close(),wsConnected=!1,wsConnect();return}wsConnected&&ws.send("alive?")};var canvas=document.getElementById("canvas"),canvasCtx=canvas.getContext("2d"),canvasData=canvasCtx.getImageData(0,0,5,1);const setupLed=()=>{for(var e=0;e<5;e++)canvasData.data[4*e+3]=255};setupLed();const updateLed=e=>{let t=new Uint8Array(e);for(var a=0;a<4;a++)canvasData.data[4*a]=t[(3-a)*3+1],canvasData.data[4*a+1]=t[(3-a)*3+2],canvasData.data[4*a+2]=t[(3-a)*3+0];canvasData.data[128]=t[94],canvasData.data[129]=t[95],canvasData.data[130]=t[93],canvasCtx.putImageData(canvasData,0,0)},fs=document.getElementById("fullscreen"),requestFullscreen=()=>{!document.fullscreenElement&&screen.height<=1024&&(fs.requestFullscreen?fs.requestFullscreen():fs.mozRequestFullScreen?fs.mozRequestFullScreen():fs.webkitRequestFullScreen&&fs.webkitRequestFullScreen())},throttledRequestFullscreen=throttle(requestFullscreen,3e3),cnt=document.getElementById("main");cnt.addEventListener("touchstart",updateTouches),cnt.addEventListener("touchmove",updateTouches),cnt.addEventListener("touchend",updateTouches);const readConfig=e=>{var t="";e.invert&&(t+=".container, .air-container {flex-flow: column-reverse nowrap;} ");var a=e.bgColor||"rbga(0, 0, 0, 0.9)";e.bgImage?t+=`#fullscreen {background: ${a} url("${e.bgImage}") fixed center / cover!important; background-repeat: no-repeat;} `:t+=`#fullscreen {background: ${a};} `,"number"==typeof e.ledOpacity&&(0===e.ledOpacity?t+="#canvas {display: none} ":t+=`#canvas {opacity: ${e.ledOpacity}} `),"string"==typeof e.keyColor&&(t+=`.key[data-active] {background-color: ${e.keyColor};} `),"string"==typeof e.keyBorderColor&&(t+=`.key {border: 1px solid ${e.keyBorderColor};} `),e.keyColorFade&&"number"==typeof e.keyColorFade&&(t+=`.key:not([data-active]) {transition: background ${e.keyColorFade}ms ease-out;} `),"number"==typeof e.keyHeight&&(0===e.keyHeight?t+=".touch-container {display: none;} ":t+=`.touch-container {flex: ${e.keyHeight};} `);var s=document.createElement("style");s.innerHTML=t,document.head.appendChild(s)},initialize=()=>{readConfig(config),compileKeys(),wsConnect(),setInterval(wsWatch,1e3)};initialize(),window.onresize=compileKeys;
\ No newline at end of file
+const throttle=(func,wait)=>{var ready=true;var args=null;return function throttled(){var context=this;if(ready){ready=false;setTimeout(function(){ready=true;if(args){throttled.apply(context);}},wait);if(args){func.apply(this,args);args=null;}else{func.apply(this,arguments);}}else{args=arguments;}};};var keys=document.getElementsByClassName("key");var touchKeys=[];var bottomKeys=touchKeys;const compileKey=(key)=>{const prev=key.previousElementSibling;const next=key.nextElementSibling;return{top:key.offsetTop,bottom:key.offsetTop+key.offsetHeight,left:key.offsetLeft,right:key.offsetLeft+key.offsetWidth,kflag:parseInt(key.dataset.kflag),prevKeyRef:prev,nextKeyRef:next,ref:key,};};const isInside=(x,y,compiledKey)=>{return(compiledKey.left<=x&&x<compiledKey.right&&compiledKey.top<=y&&y<compiledKey.bottom);};const compileKeys=()=>{keys=document.getElementsByClassName("key");touchKeys=[];for(var i=0,key;i<keys.length;i++){const compiledKey=compileKey(keys[i]);touchKeys.push(compiledKey);}};const getKey=(x,y)=>{for(var i=0;i<touchKeys.length;i++){if(isInside(x,y,touchKeys[i])){return touchKeys[i];}}
+return null;};var lastState=[0,0,0,0];var layoutLanes=4;var layoutGroundLanes=4;const buildKeys=(lanes,airLanes)=>{const groundLanes=lanes-airLanes;var html="";for(var i=lanes-1;i>=groundLanes;i--){html+=`<div class="key" data-kflag="${i}"></div>`;}
+document.getElementById("air").innerHTML=html;html="";for(var i=0;i<groundLanes;i++){html+=`<div class="key" data-kflag="${i}"></div>`;}
+document.getElementById("keys").innerHTML=html;layoutLanes=lanes;layoutGroundLanes=groundLanes;lastState=new Array(lanes).fill(0);compileKeys();};function updateTouches(e){try{e.preventDefault();var keyFlags=new Array(layoutLanes).fill(0);throttledRequestFullscreen();for(var i=0;i<e.touches.length;i++){const touch=e.touches[i];const x=touch.clientX;const y=touch.clientY;const key=getKey(x,y);if(!key)continue;setKey(keyFlags,key.kflag);}
+for(var i=0;i<touchKeys.length;i++){const key=touchKeys[i];const kflag=key.kflag;if(keyFlags[kflag]!==lastState[kflag]){if(keyFlags[kflag]){key.ref.setAttribute("data-active","");}else{key.ref.removeAttribute("data-active");}}}
+if(keyFlags!==lastState){throttledSendKeys(keyFlags);}
+lastState=keyFlags;}catch(err){alert(err);}}
+const throttledUpdateTouches=throttle(updateTouches,10);const setKey=(keyFlags,kflag)=>{var idx=kflag;if(keyFlags[idx]&&idx+1<layoutGroundLanes){idx++;}
+keyFlags[idx]=1;};var sendSequence=0;const sendKeys=(keyFlags)=>{if(wsConnected){const lanes=layoutLanes;const frame=new DataView(new ArrayBuffer(8+((lanes+7)>>3)));frame.setUint8(0,1);frame.setUint8(1,lanes);frame.setUint16(2,sendSequence,true);frame.setUint32(4,performance.now()*1000,true);for(var i=0;i<lanes;i++){if(keyFlags[i]){const byte=8+(i>>3);frame.setUint8(byte,frame.getUint8(byte)|(1<<(i&7)));}}
+sendSequence=(sendSequence+1)&0xffff;ws.send(frame.buffer);}};const throttledSendKeys=throttle(sendKeys,10);var ws=null;var wsTimeout=0;var wsConnected=false;var wsPingTime=0;var wsRtt=-1;var wsHeartbeat=0;const wsPing=()=>{wsPingTime=performance.now();ws.send(wsRtt<0?"alive?":"alive?"+Math.round(wsRtt*1000));};const wsConnect=()=>{clearInterval(wsHeartbeat);ws=new WebSocket("ws://"+location.host+"/ws");ws.binaryType="arraybuffer";ws.onopen=()=>{wsPing();};ws.onmessage=(e)=>{if(e.data.byteLength){updateLed(e.data);}else if(e.data=="alive"){wsRtt=performance.now()-wsPingTime;wsTimeout=0;wsConnected=true;}else if(e.data.startsWith("sync?")){ws.send("sync"+e.data.substring(5)+","+Math.floor(performance.now()*1000));}else if(e.data.startsWith("layout")){const layout=e.data.substring(6).split(",");buildKeys(parseInt(layout[0]),parseInt(layout[1]));}else if(e.data.startsWith("heartbeat")){const socket=ws;clearInterval(wsHeartbeat);wsHeartbeat=setInterval(()=>{if(socket.readyState===WebSocket.OPEN){socket.send("h");}},Math.max(parseInt(e.data.substring(9))/4,5));}else if(e.data=="frame?"){sendKeys(lastState);}};};const wsWatch=()=>{if(wsTimeout++>2){wsTimeout=0;ws.close();wsConnected=false;wsConnect();return;}
+if(wsConnected){wsPing();}};var canvas=document.getElementById("canvas");var canvasCtx=canvas.getContext("2d");var canvasData=canvasCtx.getImageData(0,0,5,1);const setupLed=()=>{for(var i=0;i<5;i++){canvasData.data[i*4+3]=255;}};setupLed();const updateLed=(data)=>{const buf=new Uint8Array(data);for(var i=0;i<4;i++){canvasData.data[i*4]=buf[(3-i)*3+1];canvasData.data[i*4+1]=buf[(3-i)*3+2];canvasData.data[i*4+2]=buf[(3-i)*3+0];}
+canvasData.data[128]=buf[94];canvasData.data[129]=buf[95];canvasData.data[130]=buf[93];canvasCtx.putImageData(canvasData,0,0);};const fs=document.getElementById("fullscreen");const requestFullscreen=()=>{if(!document.fullscreenElement&&screen.height<=1024){if(fs.requestFullscreen){fs.requestFullscreen();}else if(fs.mozRequestFullScreen){fs.mozRequestFullScreen();}else if(fs.webkitRequestFullScreen){fs.webkitRequestFullScreen();}}};const throttledRequestFullscreen=throttle(requestFullscreen,3000);const cnt=document.getElementById("main");cnt.addEventListener("touchstart",updateTouches);cnt.addEventListener("touchmove",updateTouches);cnt.addEventListener("touchend",updateTouches);const readConfig=(config)=>{var style="";if(!!config.invert){style+=`.container, .air-container {flex-flow: column-reverse nowrap;} `;}
+var bgColor=config.bgColor||"rbga(0, 0, 0, 0.9)";if(!config.bgImage){style+=`#fullscreen {background: ${bgColor};} `;}else{style+=`#fullscreen {background: ${bgColor} url("${config.bgImage}") fixed center / cover!important; background-repeat: no-repeat;} `;}
+if(typeof config.ledOpacity==="number"){if(config.ledOpacity===0){style+=`#canvas {display: none} `;}else{style+=`#canvas {opacity: ${config.ledOpacity}} `;}}
+if(typeof config.keyColor==="string"){style+=`.key[data-active] {background-color: ${config.keyColor};} `;}
+if(typeof config.keyBorderColor==="string"){style+=`.key {border: 1px solid ${config.keyBorderColor};} `;}
+if(!!config.keyColorFade&&typeof config.keyColorFade==="number"){style+=`.key:not([data-active]) {transition: background ${config.keyColorFade}ms ease-out;} `;}
+if(typeof config.keyHeight==="number"){if(config.keyHeight===0){style+=`.touch-container {display: none;} `;}else{style+=`.touch-container {flex: ${config.keyHeight};} `;}}
+var styleRef=document.createElement("style");styleRef.innerHTML=style;document.head.appendChild(styleRef);};const initialize=()=>{readConfig(config);buildKeys(4,0);wsConnect();setInterval(wsWatch,1000);if("serviceWorker"in navigator&&window.isSecureContext){navigator.serviceWorker.register("/sw.js");}};initialize();window.onresize=compileKeys;
\ No newline at end of file
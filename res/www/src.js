@@ -1,5 +1,5 @@
 /*
-  Post-process with https://babeljs.io/repl and https://javascript-minifier.com/
+  app.js is generated from this file, run node res/minify.js after editing it
 */
 
 const throttle = (func, wait) => {
@@ -41,7 +41,7 @@ const compileKey = (key) => {
     bottom: key.offsetTop + key.offsetHeight,
     left: key.offsetLeft,
     right: key.offsetLeft + key.offsetWidth,
-    kflag: parseInt(key.dataset.kflag) + (parseInt(key.dataset.air) ? 32 : 0),
+    kflag: parseInt(key.dataset.kflag),
     prevKeyRef: prev,
     nextKeyRef: next,
     ref: key,
@@ -80,20 +80,36 @@ const getKey = (x, y) => {
 };
 
 // ״̬
-// prettier-ignore
-var lastState = [
-  0, 0, 0, 0,
-];
+var lastState = [0, 0, 0, 0];
+
+// Lanes left to right, then air sensors bottom to top above them
+var layoutLanes = 4;
+var layoutGroundLanes = 4;
+const buildKeys = (lanes, airLanes) => {
+  const groundLanes = lanes - airLanes;
+  var html = "";
+  for (var i = lanes - 1; i >= groundLanes; i--) {
+    html += `<div class="key" data-kflag="${i}"></div>`;
+  }
+  document.getElementById("air").innerHTML = html;
+  html = "";
+  for (var i = 0; i < groundLanes; i++) {
+    html += `<div class="key" data-kflag="${i}"></div>`;
+  }
+  document.getElementById("keys").innerHTML = html;
+
+  layoutLanes = lanes;
+  layoutGroundLanes = groundLanes;
+  lastState = new Array(lanes).fill(0);
+  compileKeys();
+};
 
 //´
 function updateTouches(e) {
   try {
     e.preventDefault();
 
-    // prettier-ignore
-    var keyFlags = [
-      0, 0, 0, 0,
-    ];
+    var keyFlags = new Array(layoutLanes).fill(0);
 
     //ȫ
     throttledRequestFullscreen();
@@ -137,16 +153,32 @@ const throttledUpdateTouches = throttle(updateTouches, 10);
 // ð״̬
 const setKey = (keyFlags, kflag) => {
   var idx = kflag;
-  if (keyFlags[idx]) {
+  // A second finger on a key presses the next ground lane, never past the last one or into the air
+  if (keyFlags[idx] && idx + 1 < layoutGroundLanes) {
     idx++;
   }
   keyFlags[idx] = 1;
 };
 
 // 
+// Binary input frame, layout documented in InputProtocol.hpp
+var sendSequence = 0;
 const sendKeys = (keyFlags) => {
   if (wsConnected) {
-    ws.send("b" + keyFlags.join(""));
+    const lanes = layoutLanes;
+    const frame = new DataView(new ArrayBuffer(8 + ((lanes + 7) >> 3)));
+    frame.setUint8(0, 1); // protocol version
+    frame.setUint8(1, lanes);
+    frame.setUint16(2, sendSequence, true);
+    frame.setUint32(4, performance.now() * 1000, true); // wraps
+    for (var i = 0; i < lanes; i++) {
+      if (keyFlags[i]) {
+        const byte = 8 + (i >> 3);
+        frame.setUint8(byte, frame.getUint8(byte) | (1 << (i & 7)));
+      }
+    }
+    sendSequence = (sendSequence + 1) & 0xffff;
+    ws.send(frame.buffer);
   }
 };
 const throttledSendKeys = throttle(sendKeys, 10);
@@ -155,18 +187,46 @@ const throttledSendKeys = throttle(sendKeys, 10);
 var ws = null;
 var wsTimeout = 0;
 var wsConnected = false;
+var wsPingTime = 0;
+var wsRtt = -1;
+var wsHeartbeat = 0;
+// Report the last round trip time (microseconds) with each ping for the server's /metrics
+const wsPing = () => {
+  wsPingTime = performance.now();
+  ws.send(wsRtt < 0 ? "alive?" : "alive?" + Math.round(wsRtt * 1000));
+};
 const wsConnect = () => {
+  clearInterval(wsHeartbeat);
   ws = new WebSocket("ws://" + location.host + "/ws");
   ws.binaryType = "arraybuffer";
   ws.onopen = () => {
-    ws.send("alive?");
+    wsPing();
   };
   ws.onmessage = (e) => {
     if (e.data.byteLength) {
       updateLed(e.data);
     } else if (e.data == "alive") {
+      wsRtt = performance.now() - wsPingTime;
       wsTimeout = 0;
       wsConnected = true;
+    } else if (e.data.startsWith("sync?")) {
+      // Clock sync, echo the server time with ours (same clock as input frame timestamps)
+      ws.send("sync" + e.data.substring(5) + "," + Math.floor(performance.now() * 1000));
+    } else if (e.data.startsWith("layout")) {
+      const layout = e.data.substring(6).split(",");
+      buildKeys(parseInt(layout[0]), parseInt(layout[1]));
+    } else if (e.data.startsWith("heartbeat")) {
+      // The server releases our lanes if it hears nothing for this many ms, beat a few times per deadline
+      const socket = ws;
+      clearInterval(wsHeartbeat);
+      wsHeartbeat = setInterval(() => {
+        if (socket.readyState === WebSocket.OPEN) {
+          socket.send("h");
+        }
+      }, Math.max(parseInt(e.data.substring(9)) / 4, 5));
+    } else if (e.data == "frame?") {
+      // Lanes were released while we were silent, send the ones still held
+      sendKeys(lastState);
     }
   };
 };
@@ -179,7 +239,7 @@ const wsWatch = () => {
     return;
   }
   if (wsConnected) {
-    ws.send("alive?");
+    wsPing();
   }
 };
 
@@ -278,9 +338,13 @@ const readConfig = (config) => {
 // ʼ
 const initialize = () => {
   readConfig(config);
-  compileKeys();
+  buildKeys(4, 0);
   wsConnect();
   setInterval(wsWatch, 1000);
+  // Offline shell, browsers only run service workers on https or localhost
+  if ("serviceWorker" in navigator && window.isSecureContext) {
+    navigator.serviceWorker.register("/sw.js");
+  }
 };
 initialize();
 
@@ -0,0 +1,78 @@
+// Offline shell for the controller page. The page is answered from cache at
+// once and refreshed in the background, so reconnecting after a Wi-Fi drop only
+// waits for the WebSocket. Content-hashed assets never change, so once cached
+// they are never fetched again.
+const CACHE = "droidmaniac-shell-v1";
+const HASHED = /\.[0-9a-f]{8}\.[^./]+$/;
+
+self.addEventListener("install", (e) => {
+  e.waitUntil(
+    caches
+      .open(CACHE)
+      .then((cache) => cache.add("/"))
+      .then(() => self.skipWaiting())
+  );
+});
+
+self.addEventListener("activate", (e) => {
+  e.waitUntil(
+    caches
+      .keys()
+      .then((keys) => Promise.all(keys.filter((key) => key != CACHE).map((key) => caches.delete(key))))
+      .then(() => self.clients.claim())
+  );
+});
+
+// Drop hashed assets the current page no longer links to
+const prune = async (cache, html) => {
+  for (const request of await cache.keys()) {
+    const path = new URL(request.url).pathname;
+    if (HASHED.test(path) && html.indexOf(path) < 0) {
+      await cache.delete(request);
+    }
+  }
+};
+
+const refreshShell = async (cache) => {
+  const response = await fetch("/", { cache: "no-cache" });
+  if (response.ok) {
+    await cache.put("/", response.clone());
+    await prune(cache, await response.clone().text());
+  }
+  return response;
+};
+
+self.addEventListener("fetch", (e) => {
+  const url = new URL(e.request.url);
+  if (e.request.method != "GET" || url.origin != location.origin) {
+    return;
+  }
+
+  if (e.request.mode == "navigate" && (url.pathname == "/" || url.pathname == "/index.html")) {
+    e.respondWith(
+      caches.open(CACHE).then(async (cache) => {
+        const cached = await cache.match("/");
+        const refreshed = refreshShell(cache);
+        if (cached) {
+          e.waitUntil(refreshed.catch(() => {}));
+          return cached;
+        }
+        return refreshed;
+      })
+    );
+  } else if (HASHED.test(url.pathname)) {
+    e.respondWith(
+      caches.open(CACHE).then(async (cache) => {
+        const cached = await cache.match(e.request);
+        if (cached) {
+          return cached;
+        }
+        const response = await fetch(e.request);
+        if (response.ok) {
+          await cache.put(e.request, response.clone());
+        }
+        return response;
+      })
+    );
+  }
+});
@@ -172,6 +172,25 @@ WIN32_EXPORT void *us_loop_ext(struct us_loop_t *loop);
 /* Blocks the calling thread and drives the event loop until no more non-fallthrough polls are scheduled */
 WIN32_EXPORT void us_loop_run(struct us_loop_t *loop);
 
+/* Makes us_loop_run poll with a zero timeout instead of sleeping until something is ready, trading the
+ * whole core it runs on for wakeup latency. Only epoll and kqueue loops spin, libuv and GCD ignore this */
+WIN32_EXPORT void us_loop_busy_poll(struct us_loop_t *loop, int enabled);
+
+/* Opt-in low latency socket options, every field left 0 is not touched */
+struct us_low_latency_options_t {
+    /* SO_BUSY_POLL, microseconds to spin on the device queue in blocking reads and polls (Linux) */
+    int busy_poll_micros;
+    /* SO_SNDBUF and SO_RCVBUF, small buffers keep queues and so queueing delay short */
+    int buffer_size;
+    /* IP_TOS and IPV6_TCLASS, e.g. 0x10 for low delay */
+    int tos;
+    /* TCP_QUICKACK, re-armed after every read since the kernel clears it (Linux) */
+    int quickack;
+};
+
+/* Applies to sockets listened on, accepted or connected after the call, process wide. Pass NULL to turn off */
+WIN32_EXPORT void us_socket_low_latency(const struct us_low_latency_options_t *options);
+
 /* Signals the loop from any thread to wake up and execute its wakeup handler from the loop's own running thread.
  * This is the only fully thread-safe function and serves as the basis for thread safety */
 WIN32_EXPORT void us_wakeup_loop(struct us_loop_t *loop);
@@ -373,6 +373,11 @@ public:
         internalEnd(data, data.length(), false, true, closeConnection);
     }
 
+    /* End the response without a body or Content-Length, as a 304 needs. Backported from later uWS. */
+    void endWithoutBody(bool closeConnection = false) {
+        internalEnd({nullptr, 0}, 0, false, false, closeConnection);
+    }
+
     /* Try and end the response. Returns [true, true] on success.
      * Starts a timeout in some cases. Returns [ok, hasResponded] */
     std::pair<bool, bool> tryEnd(std::string_view data, size_t totalSize = 0) {
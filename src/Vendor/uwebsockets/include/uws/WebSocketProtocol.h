@@ -23,6 +23,21 @@
 #include <cstdlib>
 #include <string_view>
 
+/* Vectorised unmasking is picked at compile time, define UWS_NO_SIMD to force the scalar loops */
+#ifndef UWS_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define UWS_UNMASK_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UWS_UNMASK_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define UWS_UNMASK_NEON
+#endif
+#endif
+
 namespace uWS {
 
 /* We should not overcomplicate these */
@@ -257,6 +272,70 @@ static inline size_t formatMessage(char *dst, const char *src, size_t length, Op
 
 }
 
+/* XOR whole vector blocks of src with the 4 byte mask repeated and store them to dst.
+ * dst may equal src or lie below it, since the parser unmasks while moving the payload
+ * over its header; every block is loaded before it is stored so that is safe.
+ * Returns the bytes done, a multiple of 4 so the caller's scalar tail keeps the mask phase */
+#ifdef UWS_UNMASK_AVX2
+static inline unsigned int unmaskAVX2(char *dst, const char *src, const char *mask, unsigned int length) {
+    uint32_t m;
+    memcpy(&m, mask, 4);
+    __m256i vmask = _mm256_set1_epi32((int) m);
+    unsigned int i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(v, vmask));
+    }
+    return i;
+}
+#endif
+
+#ifdef UWS_UNMASK_SSE2
+static inline unsigned int unmaskSSE2(char *dst, const char *src, const char *mask, unsigned int length) {
+    uint32_t m;
+    memcpy(&m, mask, 4);
+    __m128i vmask = _mm_set1_epi32((int) m);
+    unsigned int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(v, vmask));
+    }
+    return i;
+}
+#endif
+
+#ifdef UWS_UNMASK_NEON
+static inline unsigned int unmaskNEON(char *dst, const char *src, const char *mask, unsigned int length) {
+    uint32_t m;
+    memcpy(&m, mask, 4);
+    uint8x16_t vmask = vreinterpretq_u8_u32(vdupq_n_u32(m));
+    unsigned int i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *) (src + i));
+        vst1q_u8((uint8_t *) (dst + i), veorq_u8(v, vmask));
+    }
+    return i;
+}
+#endif
+
+/* Widest path first, the next narrower one picks up what is left */
+static inline unsigned int unmaskVector(char *dst, const char *src, const char *mask, unsigned int length) {
+    unsigned int done = 0;
+#ifdef UWS_UNMASK_AVX2
+    done = unmaskAVX2(dst, src, mask, length);
+#endif
+#if defined(UWS_UNMASK_SSE2)
+    done += unmaskSSE2(dst + done, src + done, mask, length - done);
+#elif defined(UWS_UNMASK_NEON)
+    done += unmaskNEON(dst + done, src + done, mask, length - done);
+#endif
+    (void) dst;
+    (void) src;
+    (void) mask;
+    (void) length;
+    return done;
+}
+
 // essentially this is only a parser
 template <const bool isServer, typename Impl>
 struct WIN32_EXPORT WebSocketProtocol {
@@ -273,7 +352,10 @@ protected:
     static inline bool rsv1(char *frame) {return *((unsigned char *) frame) & 64;}
 
     static inline void unmaskImprecise(char *dst, char *src, char *mask, unsigned int length) {
-        for (unsigned int n = (length >> 2) + 1; n; n--) {
+        unsigned int done = unmaskVector(dst, src, mask, ((length >> 2) + 1) * 4);
+        dst += done;
+        src += done;
+        for (unsigned int n = (length >> 2) + 1 - (done >> 2); n; n--) {
             *(dst++) = *(src++) ^ mask[0];
             *(dst++) = *(src++) ^ mask[1];
             *(dst++) = *(src++) ^ mask[2];
@@ -295,6 +377,9 @@ protected:
     }
 
     static inline void unmaskInplace(char *data, char *stop, char *mask) {
+        if (data < stop) {
+            data += unmaskVector(data, data, mask, (unsigned int) (stop - data));
+        }
         while (data < stop) {
             *(data++) ^= mask[0];
             *(data++) ^= mask[1];
@@ -66,6 +66,50 @@ void bsd_socket_flush(LIBUS_SOCKET_DESCRIPTOR fd) {
 #endif
 }
 
+/* Zeroed, so off, unless us_socket_low_latency was called */
+static struct us_low_latency_options_t low_latency_options;
+
+void us_socket_low_latency(const struct us_low_latency_options_t *options) {
+    if (options) {
+        low_latency_options = *options;
+    } else {
+        struct us_low_latency_options_t off = {0};
+        low_latency_options = off;
+    }
+}
+
+/* Best effort, options the platform or socket family lacks are skipped */
+void bsd_socket_low_latency(LIBUS_SOCKET_DESCRIPTOR fd) {
+    if (low_latency_options.buffer_size) {
+        int size = low_latency_options.buffer_size;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, (SETSOCKOPT_PTR_TYPE) &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (SETSOCKOPT_PTR_TYPE) &size, sizeof(size));
+    }
+
+    if (low_latency_options.tos) {
+        int tos = low_latency_options.tos;
+        /* Dual stack sockets carry IPv4 traffic too, so set both */
+        setsockopt(fd, IPPROTO_IP, IP_TOS, (SETSOCKOPT_PTR_TYPE) &tos, sizeof(tos));
+#ifdef IPV6_TCLASS
+        setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, (SETSOCKOPT_PTR_TYPE) &tos, sizeof(tos));
+#endif
+    }
+
+#ifdef SO_BUSY_POLL
+    if (low_latency_options.busy_poll_micros) {
+        int micros = low_latency_options.busy_poll_micros;
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &micros, sizeof(micros));
+    }
+#endif
+
+#ifdef TCP_QUICKACK
+    if (low_latency_options.quickack) {
+        int enabled = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &enabled, sizeof(enabled));
+    }
+#endif
+}
+
 LIBUS_SOCKET_DESCRIPTOR bsd_create_socket(int domain, int type, int protocol) {
     // returns INVALID_SOCKET on error
     int flags = 0;
@@ -169,11 +213,24 @@ LIBUS_SOCKET_DESCRIPTOR bsd_accept_socket(LIBUS_SOCKET_DESCRIPTOR fd, struct bsd
 
     internal_finalize_bsd_addr(addr);
 
+    /* Most options are inherited from the listen socket, but not all of them on every platform */
+    bsd_socket_low_latency(accepted_fd);
+
     return bsd_set_nonblocking(apple_no_sigpipe(accepted_fd));
 }
 
 int bsd_recv(LIBUS_SOCKET_DESCRIPTOR fd, void *buf, int length, int flags) {
-    return recv(fd, buf, length, flags);
+    int received = recv(fd, buf, length, flags);
+
+#ifdef TCP_QUICKACK
+    /* The kernel drops back to delayed acks on its own, costs one syscall per read */
+    if (low_latency_options.quickack && received > 0) {
+        int enabled = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &enabled, sizeof(enabled));
+    }
+#endif
+
+    return received;
 }
 
 int bsd_send(LIBUS_SOCKET_DESCRIPTOR fd, const char *buf, int length, int msg_more) {
@@ -261,6 +318,9 @@ LIBUS_SOCKET_DESCRIPTOR bsd_create_listen_socket(const char *host, int port, int
     setsockopt(listenFd, IPPROTO_IPV6, IPV6_V6ONLY, (SETSOCKOPT_PTR_TYPE) &disabled, sizeof(disabled));
 #endif
 
+    /* Buffer sizes have to be in place before listen to shape the advertised window */
+    bsd_socket_low_latency(listenFd);
+
     if (bind(listenFd, listenAddr->ai_addr, (socklen_t) listenAddr->ai_addrlen) || listen(listenFd, 512)) {
         bsd_close_socket(listenFd);
         freeaddrinfo(result);
@@ -301,6 +361,8 @@ LIBUS_SOCKET_DESCRIPTOR bsd_create_connect_socket(const char *host, int port, co
         }
     }
 
+    bsd_socket_low_latency(fd);
+
     connect(fd, result->ai_addr, (socklen_t) result->ai_addrlen);
     freeaddrinfo(result);
 
@@ -99,6 +99,7 @@ struct us_loop_t *us_create_loop(void *hint, void (*wakeup_cb)(struct us_loop_t
     /* These could be accessed if we close a poll before starting the loop */
     loop->num_ready_polls = 0;
     loop->current_ready_poll = 0;
+    loop->busy_poll = 0;
 
 #ifdef LIBUS_USE_EPOLL
     loop->fd = epoll_create1(EPOLL_CLOEXEC);
@@ -110,6 +111,10 @@ struct us_loop_t *us_create_loop(void *hint, void (*wakeup_cb)(struct us_loop_t
     return loop;
 }
 
+void us_loop_busy_poll(struct us_loop_t *loop, int enabled) {
+    loop->busy_poll = enabled;
+}
+
 void us_loop_run(struct us_loop_t *loop) {
     us_loop_integrate(loop);
 
@@ -118,12 +123,15 @@ void us_loop_run(struct us_loop_t *loop) {
         /* Emit pre callback */
         us_internal_loop_pre(loop);
 
-        /* Fetch ready polls */
+        /* Fetch ready polls, spinning in place of sleeping when busy polling */
+        do {
 #ifdef LIBUS_USE_EPOLL
-        loop->num_ready_polls = epoll_wait(loop->fd, loop->ready_polls, 1024, -1);
+            loop->num_ready_polls = epoll_wait(loop->fd, loop->ready_polls, 1024, loop->busy_poll ? 0 : -1);
 #else
-        loop->num_ready_polls = kevent(loop->fd, NULL, 0, loop->ready_polls, 1024, NULL);
+            struct timespec zero = {0, 0};
+            loop->num_ready_polls = kevent(loop->fd, NULL, 0, loop->ready_polls, 1024, loop->busy_poll ? &zero : NULL);
 #endif
+        } while (loop->num_ready_polls == 0 && loop->busy_poll);
 
         /* Iterate ready polls, dispatching them by type */
         for (loop->current_ready_poll = 0; loop->current_ready_poll < loop->num_ready_polls; loop->current_ready_poll++) {
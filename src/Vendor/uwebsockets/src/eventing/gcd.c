@@ -46,6 +46,10 @@ void us_loop_free(struct us_loop_t *loop) {
  * It will be up to the user to link to CoreFoundation, however that should be automatic in most use cases */
 extern void CFRunLoopRun();
 
+/* The run loop belongs to CoreFoundation, there is nothing to spin on */
+void us_loop_busy_poll(struct us_loop_t *loop, int enabled) {
+}
+
 void us_loop_run(struct us_loop_t *loop) {
     us_loop_integrate(loop);
 
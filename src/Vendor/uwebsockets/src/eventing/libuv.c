@@ -182,6 +182,10 @@ void us_loop_free(struct us_loop_t *loop) {
     free(loop);
 }
 
+/* libuv owns the wait, there is nothing to spin on */
+void us_loop_busy_poll(struct us_loop_t *loop, int enabled) {
+}
+
 void us_loop_run(struct us_loop_t *loop) {
     us_loop_integrate(loop);
 
@@ -49,6 +49,9 @@ struct us_loop_t {
     /* Loop's own file descriptor */
     int fd;
 
+    /* Poll with a zero timeout instead of sleeping */
+    int busy_poll;
+
     /* The list of ready polls */
 #ifdef LIBUS_USE_EPOLL
     struct epoll_event ready_polls[1024];
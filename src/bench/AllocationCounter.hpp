@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// Linking this in replaces the global operator new and delete with versions that
+// count every allocation, for benchmarks that check a path never allocates.
+
+// Allocations made through any form of operator new since the program started
+uint64_t allocation_count();
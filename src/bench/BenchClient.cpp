@@ -0,0 +1,369 @@
+#include "BenchClient.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "Clock.hpp"
+
+#ifdef _WIN32
+
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+
+typedef SOCKET socket_t;
+static constexpr socket_t INVALID_SOCKET_FD = INVALID_SOCKET;
+
+static bool would_block()
+{
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+static void set_non_blocking(socket_t fd)
+{
+    u_long enabled = 1;
+    ioctlsocket(fd, FIONBIO, &enabled);
+}
+
+static void close_socket(socket_t fd)
+{
+    closesocket(fd);
+}
+
+#else
+
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int socket_t;
+static constexpr socket_t INVALID_SOCKET_FD = -1;
+
+static bool would_block()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static void set_non_blocking(socket_t fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void close_socket(socket_t fd)
+{
+    ::close(fd);
+}
+
+#endif
+
+static constexpr uint8_t OPCODE_TEXT = 0x1;
+static constexpr uint8_t OPCODE_BINARY = 0x2;
+static constexpr uint8_t OPCODE_CLOSE = 0x8;
+static constexpr uint8_t OPCODE_PING = 0x9;
+static constexpr uint8_t OPCODE_PONG = 0xA;
+
+// Frame header plus mask
+static constexpr size_t MAX_HEADER_SIZE = 14;
+
+struct BenchClient::Impl
+{
+    socket_t m_socket;
+    uint32_t m_mask_seed;
+
+    char m_send_buffer[MAX_HEADER_SIZE + MAX_MESSAGE_SIZE];
+
+    // Received bytes, [m_consumed, m_size) is not parsed yet
+    char m_receive_buffer[4 * (MAX_HEADER_SIZE + MAX_MESSAGE_SIZE)];
+    size_t m_size;
+    size_t m_consumed;
+
+    Impl() : m_socket(INVALID_SOCKET_FD), m_mask_seed(0x9e3779b9), m_size(0), m_consumed(0) {}
+
+    bool write_all(const char *data, size_t size)
+    {
+        while (size)
+        {
+            int sent = ::send(m_socket, data, static_cast<int>(size), 0);
+            if (sent < 0)
+            {
+                if (!would_block())
+                {
+                    return false;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool send_frame(uint8_t opcode, const uint8_t *data, size_t size)
+    {
+        if (m_socket == INVALID_SOCKET_FD || size > MAX_MESSAGE_SIZE)
+        {
+            return false;
+        }
+
+        uint8_t *out = reinterpret_cast<uint8_t *>(m_send_buffer);
+        size_t header = 2;
+        out[0] = 0x80 | opcode;
+        if (size < 126)
+        {
+            out[1] = 0x80 | static_cast<uint8_t>(size);
+        }
+        else
+        {
+            out[1] = 0x80 | 126;
+            out[2] = static_cast<uint8_t>(size >> 8);
+            out[3] = static_cast<uint8_t>(size);
+            header = 4;
+        }
+
+        // Clients must mask, the key only has to be unpredictable to proxies
+        m_mask_seed ^= m_mask_seed << 13;
+        m_mask_seed ^= m_mask_seed >> 17;
+        m_mask_seed ^= m_mask_seed << 5;
+        uint8_t *mask = out + header;
+        std::memcpy(mask, &m_mask_seed, 4);
+        header += 4;
+
+        for (size_t i = 0; i < size; i++)
+        {
+            out[header + i] = data[i] ^ mask[i % 4];
+        }
+        return write_all(m_send_buffer, header + size);
+    }
+
+    // Moves unparsed bytes to the front and reads whatever the socket has
+    bool fill()
+    {
+        if (m_consumed)
+        {
+            std::memmove(m_receive_buffer, m_receive_buffer + m_consumed, m_size - m_consumed);
+            m_size -= m_consumed;
+            m_consumed = 0;
+        }
+
+        int received = ::recv(m_socket, m_receive_buffer + m_size, static_cast<int>(sizeof(m_receive_buffer) - m_size), 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        m_size += received;
+        return true;
+    }
+};
+
+BenchClient::BenchClient() : m_impl(std::make_unique<Impl>()) {}
+
+BenchClient::~BenchClient()
+{
+    close();
+}
+
+bool BenchClient::connect(const char *host, int port, const char *path)
+{
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+    {
+        return false;
+    }
+#endif
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host, service.c_str(), &hints, &addresses) != 0)
+    {
+        spdlog::error("Cannot resolve {}", host);
+        return false;
+    }
+
+    m_impl->m_socket = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+    bool connected = m_impl->m_socket != INVALID_SOCKET_FD &&
+                     ::connect(m_impl->m_socket, addresses->ai_addr, static_cast<int>(addresses->ai_addrlen)) == 0;
+    freeaddrinfo(addresses);
+    if (!connected)
+    {
+        close();
+        return false;
+    }
+
+    // Input frames are tiny and must not wait for each other
+    int enabled = 1;
+    setsockopt(m_impl->m_socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&enabled), sizeof(enabled));
+
+    std::string request = fmt::format("GET {} HTTP/1.1\r\n"
+                                      "Host: {}:{}\r\n"
+                                      "Upgrade: websocket\r\n"
+                                      "Connection: Upgrade\r\n"
+                                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                      "Sec-WebSocket-Version: 13\r\n\r\n",
+                                      path,
+                                      host,
+                                      port);
+    if (!m_impl->write_all(request.data(), request.size()))
+    {
+        close();
+        return false;
+    }
+
+    // Anything after the response header is already WebSocket data
+    std::string_view response;
+    size_t header_end = std::string_view::npos;
+    while (header_end == std::string_view::npos)
+    {
+        if (!m_impl->fill())
+        {
+            close();
+            return false;
+        }
+        response = std::string_view(m_impl->m_receive_buffer, m_impl->m_size);
+        header_end = response.find("\r\n\r\n");
+    }
+    if (response.substr(0, 12) != "HTTP/1.1 101")
+    {
+        spdlog::error("WebSocket upgrade refused: {}", response.substr(0, response.find("\r\n")));
+        close();
+        return false;
+    }
+    m_impl->m_consumed = header_end + 4;
+
+    set_non_blocking(m_impl->m_socket);
+    return true;
+}
+
+void BenchClient::close()
+{
+    if (m_impl->m_socket != INVALID_SOCKET_FD)
+    {
+        close_socket(m_impl->m_socket);
+        m_impl->m_socket = INVALID_SOCKET_FD;
+    }
+    m_impl->m_size = 0;
+    m_impl->m_consumed = 0;
+}
+
+bool BenchClient::send_binary(const uint8_t *data, size_t size)
+{
+    return m_impl->send_frame(OPCODE_BINARY, data, size);
+}
+
+bool BenchClient::send_text(std::string_view text)
+{
+    return m_impl->send_frame(OPCODE_TEXT, reinterpret_cast<const uint8_t *>(text.data()), text.size());
+}
+
+bool BenchClient::answer_sync(std::string_view message)
+{
+    if (message.substr(0, 5) != "sync?")
+    {
+        return false;
+    }
+
+    // "sync<server time>,<our time in microseconds>"
+    std::string_view server_time = message.substr(5, 20);
+    char reply[48] = {'s', 'y', 'n', 'c'};
+    char *end = reply + 4;
+    std::memcpy(end, server_time.data(), server_time.size());
+    end += server_time.size();
+    *end++ = ',';
+    end = std::to_chars(end, reply + sizeof(reply), now_nanos() / 1000).ptr;
+    send_text(std::string_view(reply, end - reply));
+    return true;
+}
+
+bool BenchClient::wait_readable(int64_t micros)
+{
+    if (m_impl->m_socket == INVALID_SOCKET_FD)
+    {
+        return false;
+    }
+
+    // select rather than poll for its microsecond timeout, the first argument is ignored on Windows
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(m_impl->m_socket, &readable);
+    timeval timeout;
+    timeout.tv_sec = static_cast<long>(micros / 1000000);
+    timeout.tv_usec = static_cast<long>(micros % 1000000);
+    return select(static_cast<int>(m_impl->m_socket + 1), &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+bool BenchClient::receive(std::string_view &message, bool &binary)
+{
+    if (m_impl->m_socket == INVALID_SOCKET_FD)
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(m_impl->m_receive_buffer + m_impl->m_consumed);
+        size_t available = m_impl->m_size - m_impl->m_consumed;
+
+        // Server frames are never masked nor, for these small messages, fragmented
+        size_t header = 2;
+        size_t size = 0;
+        if (available >= 2)
+        {
+            size = data[1] & 0x7f;
+            if (size == 126)
+            {
+                header = 4;
+                size = available >= 4 ? (data[2] << 8) | data[3] : 0;
+            }
+            else if (size == 127)
+            {
+                header = 10;
+                size = 0;
+                for (size_t i = 0; i < 8 && available >= 10; i++)
+                {
+                    size = (size << 8) | data[2 + i];
+                }
+            }
+        }
+
+        if (available < header || available < header + size)
+        {
+            if (size > MAX_MESSAGE_SIZE || !m_impl->fill())
+            {
+                return false;
+            }
+            continue;
+        }
+
+        uint8_t opcode = data[0] & 0x0f;
+        std::string_view payload(reinterpret_cast<const char *>(data + header), size);
+        m_impl->m_consumed += header + size;
+
+        if (opcode == OPCODE_PING)
+        {
+            m_impl->send_frame(OPCODE_PONG, data + header, size);
+        }
+        else if (opcode == OPCODE_CLOSE)
+        {
+            close();
+            return false;
+        }
+        else if (opcode == OPCODE_TEXT || opcode == OPCODE_BINARY)
+        {
+            message = payload;
+            binary = opcode == OPCODE_BINARY;
+            return true;
+        }
+    }
+}
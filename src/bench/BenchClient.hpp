@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+// Minimal blocking-connect, non-blocking-read WebSocket client for the benchmarks.
+// Sending and receiving work out of fixed buffers, so a client loop that only
+// calls send_* and receive never allocates and cannot skew heap counts.
+struct BenchClient
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    // Largest message sent or received
+    static constexpr size_t MAX_MESSAGE_SIZE = 4096;
+
+    BenchClient();
+    ~BenchClient();
+
+    bool connect(const char *host, int port, const char *path);
+    void close();
+
+    bool send_binary(const uint8_t *data, size_t size);
+    bool send_text(std::string_view text);
+
+    // Next complete data message without blocking, answering pings on the way.
+    // message stays valid until the next call.
+    bool receive(std::string_view &message, bool &binary);
+
+    // Blocks until the server has sent more or micros have passed, false on timeout
+    bool wait_readable(int64_t micros);
+
+    // Answers a "sync?<server time>" clock sync request like the controller page does,
+    // with now_nanos() in microseconds as our clock. False if message is something else.
+    bool answer_sync(std::string_view message);
+};
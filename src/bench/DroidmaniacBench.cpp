@@ -0,0 +1,390 @@
+// End to end load test of the input path. Runs the server and the injector in
+// process on the recording backend, plays note patterns from N WebSocket clients
+// and reports throughput, receive to inject latency and key edges that never
+// came out the other end. Exits non-zero on lost edges or a blown latency budget,
+// so it can gate a deploy.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "optparse/optparse.hpp"
+#include "spdlog/spdlog.h"
+
+#include "BenchClient.hpp"
+#include "Bits.hpp"
+#include "BrokenithmServer.hpp"
+#include "Clock.hpp"
+#include "Injector.hpp"
+#include "InputProtocol.hpp"
+#include "KeyboardSimulator.hpp"
+#include "Logging.hpp"
+#include "PrecisionTimer.hpp"
+#include "RecordingKeyboardBackend.hpp"
+
+// Every client plays a 4 key controller on its own lanes
+static constexpr int CLIENT_LANES = 4;
+// Clients wake for a request until this close to their next note, then sleep out the rest
+static constexpr int64_t SERVICE_MARGIN_NANOS = 200000;
+
+enum Pattern
+{
+    PATTERN_STREAM, // Single notes rolling across the lanes
+    PATTERN_JACK,   // The same lane hit repeatedly
+    PATTERN_CHORD,  // Two to four lanes at once
+    PATTERN_MIXED,  // Switches between the above every 16 notes
+};
+
+static uint64_t pattern_note(Pattern pattern, uint64_t note)
+{
+    static const int STREAM[] = {0, 1, 2, 3, 2, 1};
+    static const uint64_t CHORDS[] = {0x3, 0xc, 0x9, 0x6, 0xf, 0x5, 0xa};
+
+    if (pattern == PATTERN_MIXED)
+    {
+        pattern = static_cast<Pattern>((note / 16) % PATTERN_MIXED);
+    }
+
+    switch (pattern)
+    {
+    case PATTERN_STREAM:
+        return 1ULL << STREAM[note % 6];
+    case PATTERN_JACK:
+        return 1ULL << ((note / 4) % CLIENT_LANES);
+    default:
+        return CHORDS[note % 7];
+    }
+}
+
+struct ClientResult
+{
+    uint64_t m_frames;
+    uint64_t m_edges;
+    // Edges sent per lane in order, true for presses
+    std::array<std::vector<bool>, CLIENT_LANES> m_lane_edges;
+
+    ClientResult() : m_frames(0), m_edges(0), m_lane_edges() {}
+};
+
+// Matches the edges injected on a lane against those sent in order, anything left over on
+// either side is an edge lost or one that should not be there
+static void compare_edges(const std::vector<bool> &sent, const std::vector<bool> &injected, uint64_t &lost, uint64_t &extra)
+{
+    size_t matched = 0;
+    for (bool pressed : injected)
+    {
+        if (matched < sent.size() && sent[matched] == pressed)
+        {
+            matched++;
+        }
+        else
+        {
+            extra++;
+        }
+    }
+    lost += sent.size() - matched;
+}
+
+static std::atomic_bool s_running(true);
+
+// Presses each note for hold of its slot and releases it for the rest, pings once a
+// second and answers clock syncs like the controller page. Always ends released.
+static void run_client(BenchClient &client, Pattern pattern, int notes_per_second, double hold, int index, ClientResult &result)
+{
+    PrecisionTimer timer;
+    const int64_t period = 1000000000LL / notes_per_second;
+    const int64_t hold_time = static_cast<int64_t>(period * hold);
+    int64_t start = now_nanos();
+    int64_t next_ping = start;
+
+    uint8_t frame[INPUT_FRAME_HEADER_SIZE + 1] = {INPUT_PROTOCOL_VERSION, CLIENT_LANES};
+    uint16_t sequence = 0;
+    uint64_t buttons = 0;
+
+    auto send_buttons = [&](uint64_t next) {
+        uint32_t client_micros = static_cast<uint32_t>(now_nanos() / 1000);
+        frame[2] = static_cast<uint8_t>(sequence);
+        frame[3] = static_cast<uint8_t>(sequence >> 8);
+        std::memcpy(frame + 4, &client_micros, 4);
+        frame[8] = static_cast<uint8_t>(next);
+        sequence++;
+        if (client.send_binary(frame, sizeof(frame)))
+        {
+            result.m_frames++;
+            result.m_edges += bit_count(buttons ^ next);
+            for (int lane = 0; lane < CLIENT_LANES; lane++)
+            {
+                uint64_t bit = 1ULL << lane;
+                if ((buttons ^ next) & bit)
+                {
+                    result.m_lane_edges[lane].push_back((next & bit) != 0);
+                }
+            }
+            buttons = next;
+        }
+    };
+
+    auto service = [&]() {
+        std::string_view message;
+        bool binary;
+        while (client.receive(message, binary))
+        {
+            client.answer_sync(message);
+        }
+        if (now_nanos() >= next_ping)
+        {
+            client.send_text("alive?");
+            next_ping += 1000000000LL;
+        }
+    };
+
+    // Answers syncs as they arrive rather than once per note, so the server's round trip
+    // filter measures the socket and not how long we took to look at it
+    auto wait_until = [&](int64_t deadline) {
+        service();
+        int64_t remaining;
+        while ((remaining = deadline - now_nanos()) > SERVICE_MARGIN_NANOS)
+        {
+            client.wait_readable((remaining - SERVICE_MARGIN_NANOS) / 1000);
+            service();
+        }
+        timer.sleep_until(deadline);
+    };
+
+    for (uint64_t note = index; s_running; note++)
+    {
+        int64_t note_start = start + static_cast<int64_t>(note - index) * period;
+        wait_until(note_start);
+        send_buttons(pattern_note(pattern, note));
+        wait_until(note_start + hold_time);
+        send_buttons(0);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    optparse::OptionParser parser = optparse::OptionParser()
+                                        .description("Plays note patterns from several WebSocket controllers against an in-process server and reports input latency and lost key edges");
+
+    parser.add_option("-p", "--port").dest("port").type("int").set_default(11162).help("Port for the in-process server");
+    parser.add_option("-c", "--clients").dest("clients").type("int").set_default(4).help("Concurrent controllers, 4 lanes each (1-16)");
+    const char *const patterns[] = {"stream", "jack", "chord", "mixed"};
+    parser.add_option("--pattern").dest("pattern").choices(&patterns[0], &patterns[4]).set_default("mixed").help("Notes to play, stream, jack, chord or all of them in turn (mixed)");
+    parser.add_option("-n", "--nps").dest("nps").type("int").set_default(20).help("Notes per second per controller (1-1000)");
+    parser.add_option("--hold").dest("hold").type("double").set_default(0.5).help("Fraction of each note's slot it is held for (0.05-0.95)");
+    const char *const dispatch_modes[] = {"event", "poll", "scheduled"};
+    parser.add_option("-m", "--mode").dest("mode").choices(&dispatch_modes[0], &dispatch_modes[3]).set_default("event").help("Injector dispatch mode, as brokenithm-kb --mode");
+    parser.add_option("-f", "--frequency").dest("frequency").type("int").set_default(1000).help("Polling frequency in poll mode");
+    parser.add_option("--delay").dest("delay").type("int").set_default(30).help("Touch to keystroke delay in scheduled mode, milliseconds");
+    parser.add_option("-w", "--warmup").dest("warmup").type("int").set_default(2).help("Seconds before latency is recorded");
+    parser.add_option("-t", "--time").dest("time").type("int").set_default(10).help("Seconds to record for");
+    const char *const log_modes[] = {"off", "sync", "async"};
+    parser.add_option("--log").dest("log").choices(&log_modes[0], &log_modes[3]).set_default("off").help("Debug logging while playing, none (off), written out by the logging thread itself (sync) or queued for a background thread (async); per key messages need a build with DROIDMANIAC_LOG_LEVEL=debug");
+    parser.add_option("--max-p99").dest("max_p99").type("int").set_default(0).help("Fail if receive to inject p99 exceeds this many microseconds (0 to disable)");
+
+    const optparse::Values options = parser.parse_args(argc, argv);
+
+    int port = static_cast<int>(options.get("port"));
+    int n_clients = static_cast<int>(options.get("clients"));
+    int notes_per_second = static_cast<int>(options.get("nps"));
+    double hold = static_cast<double>(options.get("hold"));
+    int frequency = static_cast<int>(options.get("frequency"));
+    int delay = static_cast<int>(options.get("delay"));
+    int warmup = static_cast<int>(options.get("warmup"));
+    int seconds = static_cast<int>(options.get("time"));
+    int max_p99 = static_cast<int>(options.get("max_p99"));
+    if (n_clients < 1 || MAX_CONTROLLERS / CLIENT_LANES < n_clients ||
+        notes_per_second < 1 || 1000 < notes_per_second ||
+        hold < 0.05 || 0.95 < hold ||
+        frequency < 1 || 1000 < frequency ||
+        delay < 1 || 1000 < delay ||
+        warmup < 0 || seconds < 1 || max_p99 < 0)
+    {
+        spdlog::error("Invalid options");
+        exit(1);
+    }
+
+    std::string pattern_name = options["pattern"];
+    Pattern pattern = PATTERN_MIXED;
+    for (int i = 0; i < 4; i++)
+    {
+        if (pattern_name == patterns[i])
+        {
+            pattern = static_cast<Pattern>(i);
+        }
+    }
+
+    std::string mode = options["mode"];
+    Injector::DispatchMode dispatch_mode = Injector::DISPATCH_EVENT;
+    if (mode == "poll")
+    {
+        dispatch_mode = Injector::DISPATCH_POLL;
+    }
+    else if (mode == "scheduled")
+    {
+        dispatch_mode = Injector::DISPATCH_SCHEDULED;
+    }
+
+    std::string log_mode = options["log"];
+    if (log_mode == "async")
+    {
+        use_async_logging();
+    }
+    spdlog::set_level(log_mode == "off" ? spdlog::level::warn : spdlog::level::debug);
+
+    // Client n connects n-th and so drives lanes [4n, 4n + 4)
+    BrokenithmServer server(port);
+    server.set_merge_policy(ControllerState::MERGE_LANES, CLIENT_LANES);
+    if (!server.start_server())
+    {
+        return 1;
+    }
+    ControllerState &controller = server.get_controller();
+    Metrics &metrics = server.get_metrics();
+
+    // Uncapped, every event is collected at the end and checked against what was sent
+    std::unique_ptr<RecordingKeyboardBackend> backend = std::make_unique<RecordingKeyboardBackend>(MAX_CONTROLLERS, SIZE_MAX);
+    RecordingKeyboardBackend &recorder = *backend;
+    KeyboardSimulator keyboard(std::move(backend));
+
+    Injector injector(controller, keyboard, metrics, dispatch_mode, false);
+    injector.set_poll_frequency(frequency);
+    injector.set_schedule_delay(delay);
+
+    std::atomic_bool injecting(true);
+    std::thread injector_thread([&] {
+        while (injecting)
+        {
+            injector.run_once();
+        }
+    });
+
+    std::vector<BenchClient> clients(n_clients);
+    for (int i = 0; i < n_clients; i++)
+    {
+        int64_t give_up = now_nanos() + 5000000000LL;
+        while (!clients[i].connect("127.0.0.1", port, "/ws"))
+        {
+            if (now_nanos() > give_up)
+            {
+                spdlog::error("Cannot connect to the server on port {}", port);
+                exit(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    std::vector<ClientResult> results(n_clients);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n_clients; i++)
+    {
+        threads.emplace_back(run_client, std::ref(clients[i]), pattern, notes_per_second, hold, i, std::ref(results[i]));
+    }
+
+    // Warmup fills the clock sync filters, only the steady state goes into the histograms
+    std::this_thread::sleep_for(std::chrono::seconds(warmup));
+    for (LatencyHistogram *histogram : {&metrics.m_touch_to_receive, &metrics.m_receive_to_publish, &metrics.m_publish_to_inject, &metrics.m_receive_to_inject, &metrics.m_touch_to_inject, &metrics.m_schedule_lateness})
+    {
+        histogram->reset();
+    }
+    uint64_t frames = metrics.m_frames.load();
+    uint64_t injected = metrics.m_edges_injected.load();
+    int64_t start = now_nanos();
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+    frames = metrics.m_frames.load() - frames;
+    injected = metrics.m_edges_injected.load() - injected;
+    double elapsed = (now_nanos() - start) / 1e9;
+
+    s_running = false;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    // Let the last releases through, scheduled mode holds them back on purpose
+    std::this_thread::sleep_for(std::chrono::milliseconds(200 + (dispatch_mode == Injector::DISPATCH_SCHEDULED ? delay : 0)));
+    injecting = false;
+    injector_thread.join();
+
+    uint64_t sent_edges = 0;
+    uint64_t sent_frames = 0;
+    for (auto &result : results)
+    {
+        sent_edges += result.m_edges;
+        sent_frames += result.m_frames;
+    }
+
+    // A lost edge on one lane must not hide behind an extra one on another
+    std::vector<RecordedKeyEvent> events = recorder.take_events();
+    std::vector<std::vector<bool>> injected_edges(n_clients * CLIENT_LANES);
+    uint64_t lost_edges = 0;
+    uint64_t extra_edges = 0;
+    for (const RecordedKeyEvent &event : events)
+    {
+        if (event.m_lane < 0 || n_clients * CLIENT_LANES <= event.m_lane)
+        {
+            extra_edges++;
+            continue;
+        }
+        injected_edges[event.m_lane].push_back(event.m_pressed);
+    }
+    for (int i = 0; i < n_clients; i++)
+    {
+        for (int lane = 0; lane < CLIENT_LANES; lane++)
+        {
+            compare_edges(results[i].m_lane_edges[lane], injected_edges[i * CLIENT_LANES + lane], lost_edges, extra_edges);
+        }
+    }
+
+    spdlog::set_level(spdlog::level::info);
+    spdlog::info("{} clients playing {} at {} notes/s, {} dispatch, {} debug logging", n_clients, pattern_name, notes_per_second, mode, log_mode);
+    spdlog::info("{} frames received ({:.0f}/s), {} key edges injected ({:.0f}/s)", frames, frames / elapsed, injected, injected / elapsed);
+    spdlog::info("Receive to inject {}", metrics.m_receive_to_inject.summary());
+    spdlog::info("Receive to publish {}", metrics.m_receive_to_publish.summary());
+    spdlog::info("Publish to inject {}", metrics.m_publish_to_inject.summary());
+    if (metrics.m_touch_to_inject.count())
+    {
+        spdlog::info("Touch to inject {}", metrics.m_touch_to_inject.summary());
+    }
+    if (dispatch_mode == Injector::DISPATCH_SCHEDULED)
+    {
+        spdlog::info("Schedule lateness {}, {} edges arrived late", metrics.m_schedule_lateness.summary(), metrics.m_late_edges.load());
+    }
+    spdlog::info("{} frames and {} key edges sent, {} injected, {} lost, {} unexpected ({} dropped on queue overflow, {} invalid, {} duplicate, {} out of order frames)",
+                 sent_frames,
+                 sent_edges,
+                 events.size(),
+                 lost_edges,
+                 extra_edges,
+                 controller.m_dropped_edges.load(),
+                 metrics.m_invalid_frames.load(),
+                 metrics.m_duplicate_frames.load(),
+                 metrics.m_reordered_frames.load());
+
+    for (auto &client : clients)
+    {
+        client.close();
+    }
+    server.stop_server();
+
+    bool failed = false;
+    if (lost_edges || extra_edges)
+    {
+        spdlog::error("Injected key edges do not match the ones sent");
+        failed = true;
+    }
+    if (max_p99 && metrics.m_receive_to_inject.percentile(99) > max_p99 * 1000LL)
+    {
+        spdlog::error("Receive to inject p99 is over the {} us budget", max_p99);
+        failed = true;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// Measures how quickly the server's event loop answers and how often it wakes up.
+// Each client sends alive? at a fixed rate and spins until "alive" comes back, so
+// the round trip is two socket hops plus one loop wakeup on the server. Build once
+// per UWS_EVENT_LOOP to compare backends, run with and without --low-latency and
+// --busy-poll to compare socket modes, and wrap in `strace -f -c` for exact
+// syscall counts.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "optparse/optparse.hpp"
+#include "spdlog/spdlog.h"
+
+#include "BenchClient.hpp"
+#include "BrokenithmServer.hpp"
+#include "Clock.hpp"
+#include "LatencyHistogram.hpp"
+#include "PrecisionTimer.hpp"
+
+static std::atomic_bool s_running(true);
+static std::atomic_bool s_counting(false);
+
+static void run_client(BenchClient &client, int rate, LatencyHistogram &round_trip, std::atomic_uint64_t &pings)
+{
+    PrecisionTimer timer;
+    const int64_t period = 1000000000LL / rate;
+    int64_t deadline = now_nanos();
+
+    while (s_running)
+    {
+        int64_t sent_time = now_nanos();
+        if (!client.send_text("alive?"))
+        {
+            return;
+        }
+
+        // Anything else (the sync? request after connecting) is skipped, never answered,
+        // so the server has nothing to send but the pong
+        std::string_view message;
+        bool binary;
+        bool answered = false;
+        while (!answered && s_running)
+        {
+            while (client.receive(message, binary))
+            {
+                if (message == "alive")
+                {
+                    answered = true;
+                    break;
+                }
+            }
+        }
+
+        if (answered && s_counting)
+        {
+            round_trip.record(now_nanos() - sent_time);
+            pings.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        deadline += period;
+        timer.sleep_until(deadline);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    optparse::OptionParser parser = optparse::OptionParser()
+                                        .description("Measures event loop round trip latency and wakeups per message");
+
+    parser.add_option("-p", "--port").dest("port").type("int").set_default(11161).help("Port for the in-process server");
+    parser.add_option("-c", "--clients").dest("clients").type("int").set_default(1).help("Concurrent controllers (1-64)");
+    parser.add_option("-r", "--rate").dest("rate").type("int").set_default(1000).help("Pings per second per controller (1-10000)");
+    parser.add_option("-w", "--warmup").dest("warmup").type("int").set_default(2).help("Seconds before measuring starts");
+    parser.add_option("-t", "--time").dest("time").type("int").set_default(10).help("Seconds to measure for");
+    parser.add_option("--low-latency").dest("low_latency").type("bool").set_default(false).action("store_true").help("Low latency server sockets, as brokenithm-kb --low-latency");
+    parser.add_option("--busy-poll").dest("busy_poll").type("bool").set_default(false).action("store_true").help("Spin the server's event loop, as brokenithm-kb --busy-poll");
+
+    const optparse::Values options = parser.parse_args(argc, argv);
+
+    int port = static_cast<int>(options.get("port"));
+    int n_clients = static_cast<int>(options.get("clients"));
+    int rate = static_cast<int>(options.get("rate"));
+    int warmup = static_cast<int>(options.get("warmup"));
+    int seconds = static_cast<int>(options.get("time"));
+    bool low_latency = static_cast<bool>(options.get("low_latency"));
+    bool busy_poll = static_cast<bool>(options.get("busy_poll"));
+    if (n_clients < 1 || 64 < n_clients || rate < 1 || 10000 < rate || warmup < 0 || seconds < 1)
+    {
+        spdlog::error("Invalid options");
+        exit(1);
+    }
+
+    spdlog::set_level(spdlog::level::warn);
+
+    BrokenithmServer server(port);
+    server.set_low_latency(low_latency, busy_poll);
+    if (!server.start_server())
+    {
+        return 1;
+    }
+    Metrics &metrics = server.get_metrics();
+
+    std::vector<BenchClient> clients(n_clients);
+    for (int i = 0; i < n_clients; i++)
+    {
+        int64_t give_up = now_nanos() + 5000000000LL;
+        while (!clients[i].connect("127.0.0.1", port, "/ws"))
+        {
+            if (now_nanos() > give_up)
+            {
+                spdlog::error("Cannot connect to the server on port {}", port);
+                exit(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    LatencyHistogram round_trip;
+    std::atomic_uint64_t pings(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n_clients; i++)
+    {
+        threads.emplace_back(run_client, std::ref(clients[i]), rate, std::ref(round_trip), std::ref(pings));
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(warmup));
+
+    uint64_t wakeups = metrics.m_loop_wakeups.load();
+    s_counting = true;
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    s_counting = false;
+    wakeups = metrics.m_loop_wakeups.load() - wakeups;
+
+    s_running = false;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    uint64_t messages = pings.load();
+    spdlog::set_level(spdlog::level::info);
+    spdlog::info("{} event loop{}{}, {} clients at {} Hz, {} pings answered",
+                 BrokenithmServer::event_loop(),
+                 low_latency ? ", low latency sockets" : "",
+                 busy_poll ? ", busy polling" : "",
+                 n_clients,
+                 rate,
+                 messages);
+    spdlog::info("Round trip {}", round_trip.summary());
+    spdlog::info("{} loop wakeups, {:.3f} per message", wakeups, messages ? static_cast<double>(wakeups) / messages : 0.0);
+
+    for (auto &client : clients)
+    {
+        client.close();
+    }
+    server.stop_server();
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Compares the vectorised WebSocket unmasking paths compiled into this build
+// against the plain 4 bytes per step loop uWS used before, across payload sizes.
+// Each path is checked against the scalar result before it is timed.
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "optparse/optparse.hpp"
+#include "spdlog/spdlog.h"
+// WebSocketProtocol.h expects WIN32_EXPORT from here
+#include "libusockets.h"
+#include "uws/WebSocketProtocol.h"
+
+#include "Clock.hpp"
+
+typedef unsigned int (*UnmaskFunction)(char *dst, const char *src, const char *mask, unsigned int length);
+
+struct UnmaskPath
+{
+    const char *m_name;
+    UnmaskFunction m_unmask;
+};
+
+static unsigned int unmask_scalar(char *dst, const char *src, const char *mask, unsigned int length)
+{
+    for (unsigned int n = length >> 2; n; n--)
+    {
+        *(dst++) = *(src++) ^ mask[0];
+        *(dst++) = *(src++) ^ mask[1];
+        *(dst++) = *(src++) ^ mask[2];
+        *(dst++) = *(src++) ^ mask[3];
+    }
+    return length & ~3u;
+}
+
+// Vector blocks plus a scalar tail, the way the parser calls them
+template <UnmaskFunction VECTOR>
+static unsigned int unmask_with_tail(char *dst, const char *src, const char *mask, unsigned int length)
+{
+    unsigned int done = VECTOR(dst, src, mask, length);
+    return done + unmask_scalar(dst + done, src + done, mask, length - done);
+}
+
+static const UnmaskPath PATHS[] = {
+    {"scalar", unmask_scalar},
+#ifdef UWS_UNMASK_SSE2
+    {"sse2", unmask_with_tail<uWS::unmaskSSE2>},
+#endif
+#ifdef UWS_UNMASK_AVX2
+    {"avx2", unmask_with_tail<uWS::unmaskAVX2>},
+#endif
+#ifdef UWS_UNMASK_NEON
+    {"neon", unmask_with_tail<uWS::unmaskNEON>},
+#endif
+    {"selected", unmask_with_tail<uWS::unmaskVector>},
+};
+
+int main(int argc, char **argv)
+{
+    optparse::OptionParser parser = optparse::OptionParser()
+                                        .description("Measures WebSocket payload unmasking throughput per implementation");
+
+    parser.add_option("-b", "--bytes").dest("bytes").type("int").set_default(256 * 1024 * 1024).help("Bytes to unmask per path and payload size");
+
+    const optparse::Values options = parser.parse_args(argc, argv);
+    int64_t total_bytes = static_cast<int64_t>(options.get("bytes"));
+    if (total_bytes < 1)
+    {
+        spdlog::error("Invalid byte count {}", total_bytes);
+        exit(1);
+    }
+
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    const unsigned int sizes[] = {8, 16, 32, 64, 128, 256, 1024, 4096, 16384, 65536};
+
+    // Offset by one so no path gets aligned loads for free
+    std::vector<char> source(65536 + 64);
+    std::vector<char> expected(65536 + 64);
+    std::vector<char> output(65536 + 64);
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        source[i] = static_cast<char>(i * 131 + 7);
+    }
+
+    for (unsigned int size : sizes)
+    {
+        std::string line = fmt::format("{:>6} B", size);
+        double scalar_nanos = 0;
+        for (const UnmaskPath &path : PATHS)
+        {
+            unmask_scalar(expected.data(), source.data() + 1, mask, size);
+            std::memset(output.data(), 0, output.size());
+            path.m_unmask(output.data(), source.data() + 1, mask, size);
+            if (std::memcmp(output.data(), expected.data(), size) != 0)
+            {
+                spdlog::error("{} unmasking is wrong for {} byte payloads", path.m_name, size);
+                return 1;
+            }
+
+            // In place, like the parser, so the data stays in cache and the results keep changing
+            int64_t iterations = std::max<int64_t>(total_bytes / size, 1);
+            char *data = source.data() + 1;
+            int64_t start = now_nanos();
+            for (int64_t i = 0; i < iterations; i++)
+            {
+                path.m_unmask(data, data, mask, size);
+            }
+            double nanos = static_cast<double>(now_nanos() - start) / iterations;
+            if (path.m_unmask == unmask_scalar)
+            {
+                scalar_nanos = nanos;
+            }
+
+            line += fmt::format("  {} {:7.1f} ns {:6.2f} GB/s {:5.2f}x", path.m_name, nanos, size / nanos, scalar_nanos / nanos);
+        }
+        spdlog::info("{}", line);
+    }
+
+    return 0;
+}
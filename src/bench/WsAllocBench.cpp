@@ -0,0 +1,201 @@
+// Runs the real server in process, drives it with several WebSocket clients at a
+// sustained rate and counts heap allocations while they do. Every message on the
+// input path (frames, alive? pings and clock sync answers) must cost none.
+
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "optparse/optparse.hpp"
+#include "spdlog/spdlog.h"
+
+#include "AllocationCounter.hpp"
+#include "BenchClient.hpp"
+#include "BrokenithmServer.hpp"
+#include "Clock.hpp"
+#include "InputProtocol.hpp"
+#include "PrecisionTimer.hpp"
+
+struct ClientStats
+{
+    std::atomic_uint64_t m_messages_sent;
+    std::atomic_uint64_t m_replies;
+
+    ClientStats() : m_messages_sent(0), m_replies(0) {}
+};
+
+static std::atomic_bool s_running(true);
+
+// Touches all four lanes in turn at the given rate, pings once a second like the
+// controller page and answers every sync? request
+static void run_client(BenchClient &client, int rate, int index, ClientStats &stats)
+{
+    PrecisionTimer timer;
+    const int64_t period = 1000000000LL / rate;
+    int64_t deadline = now_nanos();
+
+    uint8_t frame[INPUT_FRAME_HEADER_SIZE + 1] = {INPUT_PROTOCOL_VERSION, 4};
+    uint16_t sequence = 0;
+
+    for (uint64_t tick = 0; s_running; tick++)
+    {
+        uint32_t client_micros = static_cast<uint32_t>(now_nanos() / 1000);
+        frame[2] = static_cast<uint8_t>(sequence);
+        frame[3] = static_cast<uint8_t>(sequence >> 8);
+        std::memcpy(frame + 4, &client_micros, 4);
+        frame[8] = static_cast<uint8_t>(1 << ((tick / 8 + index) % 4));
+        sequence++;
+        if (!client.send_binary(frame, sizeof(frame)))
+        {
+            return;
+        }
+        stats.m_messages_sent.fetch_add(1, std::memory_order_relaxed);
+
+        if (tick % rate == 0)
+        {
+            client.send_text("alive?500");
+            stats.m_messages_sent.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::string_view message;
+        bool binary;
+        while (client.receive(message, binary))
+        {
+            stats.m_replies.fetch_add(1, std::memory_order_relaxed);
+            if (client.answer_sync(message))
+            {
+                stats.m_messages_sent.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        deadline += period;
+        timer.sleep_until(deadline);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    optparse::OptionParser parser = optparse::OptionParser()
+                                        .description("Counts heap allocations per WebSocket message under sustained input");
+
+    parser.add_option("-p", "--port").dest("port").type("int").set_default(11160).help("Port for the in-process server");
+    parser.add_option("-c", "--clients").dest("clients").type("int").set_default(4).help("Concurrent controllers (1-64)");
+    parser.add_option("-r", "--rate").dest("rate").type("int").set_default(1000).help("Input frames per second per controller (1-10000)");
+    parser.add_option("-w", "--warmup").dest("warmup").type("int").set_default(2).help("Seconds before counting starts");
+    parser.add_option("-t", "--time").dest("time").type("int").set_default(10).help("Seconds to count for");
+
+    const optparse::Values options = parser.parse_args(argc, argv);
+
+    int port = static_cast<int>(options.get("port"));
+    int n_clients = static_cast<int>(options.get("clients"));
+    int rate = static_cast<int>(options.get("rate"));
+    int warmup = static_cast<int>(options.get("warmup"));
+    int seconds = static_cast<int>(options.get("time"));
+    if (n_clients < 1 || 64 < n_clients || rate < 1 || 10000 < rate || warmup < 0 || seconds < 1)
+    {
+        spdlog::error("Invalid options");
+        exit(1);
+    }
+
+    spdlog::set_level(spdlog::level::warn);
+
+    BrokenithmServer server(port);
+    if (!server.start_server())
+    {
+        return 1;
+    }
+    ControllerState &controller = server.get_controller();
+    Metrics &metrics = server.get_metrics();
+
+    // Connecting logs, allocates and warms every cache before anything is counted
+    std::vector<BenchClient> clients(n_clients);
+    for (int i = 0; i < n_clients; i++)
+    {
+        int64_t give_up = now_nanos() + 5000000000LL;
+        while (!clients[i].connect("127.0.0.1", port, "/ws"))
+        {
+            if (now_nanos() > give_up)
+            {
+                spdlog::error("Cannot connect to the server on port {}", port);
+                exit(1);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    std::vector<ClientStats> stats(n_clients);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < n_clients; i++)
+    {
+        threads.emplace_back(run_client, std::ref(clients[i]), rate, i, std::ref(stats[i]));
+    }
+
+    auto drain_for = [&](int duration) {
+        KeyEdge edge;
+        int64_t end = now_nanos() + duration * 1000000000LL;
+        while (now_nanos() < end)
+        {
+            while (controller.pop_edge(edge))
+            {
+            }
+            controller.take_resync();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+
+    auto messages_sent = [&]() {
+        uint64_t total = 0;
+        for (auto &client : stats)
+        {
+            total += client.m_messages_sent.load();
+        }
+        return total;
+    };
+
+    drain_for(warmup);
+
+    uint64_t allocations = allocation_count();
+    uint64_t messages = messages_sent();
+    uint64_t frames = metrics.m_frames.load();
+    int64_t start = now_nanos();
+
+    drain_for(seconds);
+
+    allocations = allocation_count() - allocations;
+    messages = messages_sent() - messages;
+    frames = metrics.m_frames.load() - frames;
+    double elapsed = (now_nanos() - start) / 1e9;
+
+    s_running = false;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    uint64_t replies = 0;
+    for (auto &client : stats)
+    {
+        replies += client.m_replies.load();
+    }
+
+    spdlog::set_level(spdlog::level::info);
+    spdlog::info("{} clients at {} Hz: {} messages sent ({:.0f}/s), {} input frames accepted, {} replies",
+                 n_clients,
+                 rate,
+                 messages,
+                 messages / elapsed,
+                 frames,
+                 replies);
+    spdlog::info("Receive to publish latency {}", metrics.m_receive_to_publish.summary());
+    spdlog::info("{} heap allocations while counting, {:.4f} per message", allocations, messages ? static_cast<double>(allocations) / messages : 0.0);
+
+    for (auto &client : clients)
+    {
+        client.close();
+    }
+    server.stop_server();
+
+    return allocations == 0 ? 0 : 1;
+}
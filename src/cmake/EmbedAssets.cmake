@@ -0,0 +1,70 @@
+# Writes a C++ source defining EMBEDDED_ASSETS (see EmbeddedAssets.hpp) with
+# every file under ASSET_DIR as a constexpr byte array. Runs in script mode:
+#
+#   cmake -DASSET_DIR=<dir> -DOUTPUT=<file.cpp> [-DGZIP=ON] -P EmbedAssets.cmake
+#
+# GZIP also stores a gzip copy of each file, so the server has one to send
+# without being linked against zlib.
+
+if (GZIP AND CMAKE_VERSION VERSION_LESS 3.19)
+    message(WARNING "Pre-gzipping web assets needs CMake 3.19, embedding them uncompressed")
+    set(GZIP OFF)
+endif()
+
+# Turns a file into a comma separated list of hex bytes, 16 per line
+function(bytes_of FILE OUT)
+    file(READ ${FILE} HEX HEX)
+    if (HEX STREQUAL "")
+        set(${OUT} "0" PARENT_SCOPE)
+        return()
+    endif()
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+    string(REPEAT "0x..," 16 LINE)
+    string(REGEX REPLACE "(${LINE})" "\\1\n    " BYTES "${BYTES}")
+    set(${OUT} "${BYTES}" PARENT_SCOPE)
+endfunction()
+
+get_filename_component(OUTPUT_DIR ${OUTPUT} DIRECTORY)
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+
+file(GLOB_RECURSE ASSETS RELATIVE ${ASSET_DIR} ${ASSET_DIR}/*)
+list(SORT ASSETS)
+
+set(SOURCE "// Generated from ${ASSET_DIR} by EmbedAssets.cmake, do not edit\n\n#include \"EmbeddedAssets.hpp\"\n")
+set(ENTRIES "")
+set(INDEX 0)
+
+foreach(ASSET ${ASSETS})
+    file(SIZE ${ASSET_DIR}/${ASSET} SIZE)
+    bytes_of(${ASSET_DIR}/${ASSET} BYTES)
+    string(APPEND SOURCE "\nstatic constexpr unsigned char ASSET_${INDEX}[] = {\n    ${BYTES}};\n")
+
+    if (GZIP AND SIZE GREATER 0)
+        set(GZIP_FILE ${OUTPUT}.${INDEX}.gz)
+        file(ARCHIVE_CREATE OUTPUT ${GZIP_FILE} PATHS ${ASSET_DIR}/${ASSET} FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+        file(SIZE ${GZIP_FILE} GZIP_SIZE)
+        bytes_of(${GZIP_FILE} GZIP_BYTES)
+        file(REMOVE ${GZIP_FILE})
+        string(APPEND SOURCE "static constexpr unsigned char ASSET_${INDEX}_GZIP[] = {\n    ${GZIP_BYTES}};\n")
+        string(APPEND ENTRIES "    {\"/${ASSET}\", ASSET_${INDEX}, ${SIZE}, ASSET_${INDEX}_GZIP, ${GZIP_SIZE}},\n")
+    else()
+        string(APPEND ENTRIES "    {\"/${ASSET}\", ASSET_${INDEX}, ${SIZE}, nullptr, 0},\n")
+    endif()
+
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+# Zero sized arrays are not allowed, the count says the placeholder is unused
+if (INDEX EQUAL 0)
+    set(ENTRIES "    {nullptr, nullptr, 0, nullptr, 0},\n")
+endif()
+
+string(APPEND SOURCE "\nconst EmbeddedAsset EMBEDDED_ASSETS[] = {\n${ENTRIES}};\n\nconst size_t EMBEDDED_ASSET_COUNT = ${INDEX};\n")
+
+# Only touch the output when it changes, so unrelated rebuilds do not recompile it
+if (EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} OLD_SOURCE)
+endif()
+if (NOT OLD_SOURCE STREQUAL SOURCE)
+    file(WRITE ${OUTPUT} "${SOURCE}")
+endif()
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the highest set bit, x must be non-zero
+inline int highest_bit(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return static_cast<int>(i);
+#else
+    return 63 - __builtin_clzll(x);
+#endif
+}
+
+// Index of the lowest set bit, x must be non-zero
+inline int lowest_bit(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return static_cast<int>(i);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Number of set bits
+inline int bit_count(uint64_t x)
+{
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(x));
+#else
+    return __builtin_popcountll(x);
+#endif
+}
@@ -2,6 +2,13 @@
 
 #include "BrokenithmServer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <memory>
 #include <thread>
 #include <string>
 #include <vector>
@@ -10,8 +17,19 @@
 #include "uws/Loop.h"
 #include "spdlog/spdlog.h"
 
-#include "AsyncFileStreamer.hpp"
+#include "Clock.hpp"
+#include "ClockSync.hpp"
+#include "Bits.hpp"
 #include "ControllerState.hpp"
+#include "DirectoryWatcher.hpp"
+#include "InputProtocol.hpp"
+#include "Metrics.hpp"
+#include "SessionLog.hpp"
+#include "StaticAssets.hpp"
+#include "ThreadTuning.hpp"
+#include "Utils.hpp"
+
+struct ConnectionData;
 
 struct BrokenithmServer::Impl
 {
@@ -20,27 +38,89 @@ struct BrokenithmServer::Impl
     void *m_uws_loop;
     void *m_uws_socket_token;
     std::thread m_thread;
+    // Set by the server thread once it listens or has given up
+    std::promise<bool> m_started;
 
     bool m_running;
 
     ControllerState m_controller_state;
+    Metrics m_metrics;
+    ThreadTuning m_thread_tuning;
+    bool m_low_latency_sockets;
+    bool m_busy_poll_loop;
+    SessionRecorder *m_recorder;
+
+    int m_layout_lanes;
+    int m_layout_air_lanes;
+    // "layout<lanes>,<air lanes>", sent to every controller as it connects
+    std::string m_layout_message;
+
+    int m_heartbeat_deadline_millis;
+    // "heartbeat<deadline>", empty without a deadline
+    std::string m_heartbeat_message;
+    us_timer_t *m_heartbeat_timer;
+    // Connection holding each slot, so deadline checks only visit live controllers
+    std::array<ConnectionData *, MAX_CONTROLLERS> m_slot_connections;
+
+    // ASSET_DIRECTORY next to the executable, whatever the working directory is
+    std::string m_asset_root;
+    // Only touched on the uWS loop, reloads are built elsewhere and swapped in
+    std::shared_ptr<const StaticAssets> m_assets;
+    std::unique_ptr<DirectoryWatcher> m_asset_watcher;
 
     Impl(int port);
     ~Impl();
 
-    void start_server_async();
+    bool start_server_async();
     void start_server();
     void stop_server();
+
+    void watch_assets();
+    void start_heartbeat_timer();
+    void check_heartbeats();
+    void render_metrics(std::string &out);
+
+    // One per MessageType, picked by the message's first byte
+    typedef void (Impl::*MessageHandler)(ConnectionData *connection, std::string_view message, int64_t receive_time);
+
+    void handle_message(ConnectionData *connection, std::string_view message, bool binary, int64_t receive_time);
+    void ignore_message(ConnectionData *connection, std::string_view message, int64_t receive_time);
+    void handle_binary_frame(ConnectionData *connection, std::string_view message, int64_t receive_time);
+    void handle_text_frame(ConnectionData *connection, std::string_view message, int64_t receive_time);
+    void handle_ping(ConnectionData *connection, std::string_view message, int64_t receive_time);
+    void handle_sync(ConnectionData *connection, std::string_view message, int64_t receive_time);
+    void handle_heartbeat(ConnectionData *connection, std::string_view message, int64_t receive_time);
 };
 
+// Overrides for the built in web assets, relative to the executable's directory
+static const char *const ASSET_DIRECTORY = "res/www";
+
+// Replies are either constant or formatted in place, uWS copies them straight
+// into the socket's cork buffer so answering a message never touches the heap
+static constexpr std::string_view ALIVE_REPLY = "alive";
+static constexpr std::string_view SYNC_REQUEST_PREFIX = "sync?";
+static constexpr std::string_view FRAME_REQUEST = "frame?";
+
+// A sync? request unanswered for this long is given up on, its reply was lost, garbled
+// or meant for an earlier connection, and the next ping sends a fresh one
+static constexpr int64_t SYNC_TIMEOUT_NANOS = 1000000000;
+
+// Heartbeat deadlines are checked this many times per deadline, bounding how late a miss is noticed
+static constexpr int HEARTBEAT_CHECKS_PER_DEADLINE = 10;
+
+// Input frames are tiny, 32 KiB still fits the page and its assets in a few round trips
+static constexpr int LOW_LATENCY_BUSY_POLL_MICROS = 50;
+static constexpr int LOW_LATENCY_BUFFER_SIZE = 32 * 1024;
+static constexpr int LOW_LATENCY_TOS = 0x10; // IPTOS_LOWDELAY
+
 BrokenithmServer::BrokenithmServer(int port)
     : m_impl(std::make_unique<Impl>(port)){};
 
 BrokenithmServer::~BrokenithmServer() = default;
 
-void BrokenithmServer::start_server()
+bool BrokenithmServer::start_server()
 {
-    m_impl->start_server_async();
+    return m_impl->start_server_async();
 }
 
 void BrokenithmServer::stop_server()
@@ -48,9 +128,65 @@ void BrokenithmServer::stop_server()
     m_impl->stop_server();
 }
 
+void BrokenithmServer::set_merge_policy(ControllerState::MergePolicy policy, int device_lanes)
+{
+    m_impl->m_controller_state.set_merge_policy(policy, device_lanes);
+}
+
+void BrokenithmServer::set_layout(int lanes, int air_lanes)
+{
+    m_impl->m_layout_lanes = lanes;
+    m_impl->m_layout_air_lanes = air_lanes;
+    m_impl->m_controller_state.set_lanes(lanes);
+}
+
+void BrokenithmServer::set_thread_tuning(const ThreadTuning &tuning)
+{
+    m_impl->m_thread_tuning = tuning;
+}
+
+void BrokenithmServer::set_low_latency(bool sockets, bool busy_poll_loop)
+{
+    m_impl->m_low_latency_sockets = sockets;
+    m_impl->m_busy_poll_loop = busy_poll_loop;
+}
+
+void BrokenithmServer::set_recorder(SessionRecorder *recorder)
+{
+    m_impl->m_recorder = recorder;
+}
+
+void BrokenithmServer::set_heartbeat_deadline(int millis)
+{
+    m_impl->m_heartbeat_deadline_millis = millis;
+}
+
 uint64_t BrokenithmServer::get_controller_state()
 {
-    return m_impl->m_controller_state.m_button_state;
+    return m_impl->m_controller_state.merge();
+}
+
+ControllerState &BrokenithmServer::get_controller()
+{
+    return m_impl->m_controller_state;
+}
+
+Metrics &BrokenithmServer::get_metrics()
+{
+    return m_impl->m_metrics;
+}
+
+const char *BrokenithmServer::event_loop()
+{
+#if defined(LIBUS_USE_EPOLL)
+    return "epoll";
+#elif defined(LIBUS_USE_KQUEUE)
+    return "kqueue";
+#elif defined(LIBUS_USE_LIBUV)
+    return "libuv";
+#else
+    return "unknown";
+#endif
 }
 
 struct ConnectionData
@@ -60,27 +196,180 @@ struct ConnectionData
     static std::vector<ConnectionData *> s_connections;
 
     int m_uid;
+    int m_slot;
     ConnectionDataSocket *m_websocket;
 
+    // Sequence tracking for binary frames
+    bool m_has_sequence;
+    uint16_t m_last_sequence;
+    uint32_t m_last_client_time;
+    uint64_t m_frames;
+    uint64_t m_duplicate_frames;
+    uint64_t m_reordered_frames;
+    uint64_t m_skipped_frames;
+
+    // Round trip time of the alive? ping as measured by the controller, -1 until reported
+    int64_t m_rtt_micros;
+
+    // Controller clock estimate, m_sync_sent_time is the pending sync? request or 0
+    ClockSync m_clock;
+    int64_t m_sync_sent_time;
+
+    // Latest per-lane analog/position values, if the controller sends them
+    uint8_t m_analog[64];
+
+    // Liveness, only pages that have sent a heartbeat are expected to keep talking.
+    // m_silent is set once the deadline passed, m_released if that released held lanes.
+    int64_t m_last_receive_time;
+    bool m_heartbeat;
+    bool m_silent;
+    bool m_released;
+
+    // "sync?" followed by room for any int64_t, only the number is rewritten per request
+    char m_sync_request[SYNC_REQUEST_PREFIX.size() + 20];
+
     void static close_all_connections();
 
-    ConnectionData() : m_websocket(nullptr)
+    ConnectionData() : m_slot(-1),
+                       m_websocket(nullptr),
+                       m_has_sequence(false),
+                       m_last_sequence(0),
+                       m_last_client_time(0),
+                       m_frames(0),
+                       m_duplicate_frames(0),
+                       m_reordered_frames(0),
+                       m_skipped_frames(0),
+                       m_rtt_micros(-1),
+                       m_clock(),
+                       m_sync_sent_time(0),
+                       m_analog(),
+                       m_last_receive_time(0),
+                       m_heartbeat(false),
+                       m_silent(false),
+                       m_released(false)
     {
+        std::memcpy(m_sync_request, SYNC_REQUEST_PREFIX.data(), SYNC_REQUEST_PREFIX.size());
+
         m_uid = s_connection_counter;
 
         s_connection_counter++;
         s_connections.resize(s_connection_counter);
-        s_connections[m_uid] = this;
     }
 
+    // uWS builds the connection as a temporary and moves it into the socket, only the
+    // moved-to copy (the one save_socket is called on) is registered in s_connections
     ~ConnectionData()
     {
-        s_connections[m_uid] = nullptr;
+        if (s_connections[m_uid] == this)
+        {
+            s_connections[m_uid] = nullptr;
+        }
     }
 
     void save_socket(ConnectionDataSocket *websocket)
     {
         m_websocket = websocket;
+        s_connections[m_uid] = this;
+    }
+
+    // Drops duplicated and out of order frames, the newest frame always holds the full state
+    bool accept_frame(const InputFrame &frame, Metrics &metrics)
+    {
+        if (frame.m_has_sequence)
+        {
+            if (m_has_sequence)
+            {
+                int16_t delta = static_cast<int16_t>(frame.m_sequence - m_last_sequence);
+                if (delta == 0)
+                {
+                    m_duplicate_frames++;
+                    metrics.m_duplicate_frames.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                if (delta < 0)
+                {
+                    m_reordered_frames++;
+                    metrics.m_reordered_frames.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                m_skipped_frames += delta - 1;
+                metrics.m_skipped_frames.fetch_add(delta - 1, std::memory_order_relaxed);
+            }
+
+            m_has_sequence = true;
+            m_last_sequence = frame.m_sequence;
+            m_last_client_time = frame.m_client_time;
+        }
+
+        if (frame.m_analog)
+        {
+            std::memcpy(m_analog, frame.m_analog, frame.m_lanes);
+        }
+
+        m_frames++;
+        metrics.m_frames.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // "alive?" optionally followed by the previous ping's round trip time in microseconds
+    void receive_ping(std::string_view message)
+    {
+        int64_t rtt_micros;
+        auto result = std::from_chars(message.data() + 6, message.data() + message.size(), rtt_micros);
+        if (result.ec == std::errc() && result.ptr == message.data() + message.size())
+        {
+            m_rtt_micros = rtt_micros;
+        }
+    }
+
+    void send_sync()
+    {
+        m_sync_sent_time = now_nanos();
+        char *end = std::to_chars(m_sync_request + SYNC_REQUEST_PREFIX.size(), m_sync_request + sizeof(m_sync_request), m_sync_sent_time).ptr;
+        m_websocket->send(std::string_view(m_sync_request, end - m_sync_request), uWS::TEXT);
+    }
+
+    // "sync<server time>,<controller time in microseconds>", the answer to send_sync()
+    void receive_sync(std::string_view message, int64_t receive_time)
+    {
+        const char *end = message.data() + message.size();
+
+        int64_t server_time;
+        auto result = std::from_chars(message.data() + 4, end, server_time);
+        if (result.ec != std::errc() || result.ptr == end || *result.ptr != ',' || server_time != m_sync_sent_time)
+        {
+            return;
+        }
+
+        int64_t client_micros;
+        result = std::from_chars(result.ptr + 1, end, client_micros);
+        if (result.ec != std::errc() || result.ptr != end)
+        {
+            return;
+        }
+
+        m_sync_sent_time = 0;
+        m_clock.add_sample(server_time, client_micros, receive_time);
+
+        // Fill the filter quickly after connecting, afterwards one sample per alive? ping is plenty
+        if (m_clock.m_n_samples < ClockSync::N_SAMPLES)
+        {
+            send_sync();
+        }
+    }
+
+    // When the controller sampled this frame in our clock, 0 if its clock is not known yet
+    int64_t touch_time(const InputFrame &frame, int64_t receive_time, Metrics &metrics)
+    {
+        if (!frame.m_has_sequence || !m_clock.synced())
+        {
+            return 0;
+        }
+
+        // The estimate can land slightly in the future, the frame cannot
+        int64_t touch_time = std::min(m_clock.to_server_time(frame.m_client_time, receive_time), receive_time);
+        metrics.m_touch_to_receive.record(receive_time - touch_time);
+        return touch_time;
     }
 };
 
@@ -98,57 +387,253 @@ void ConnectionData::close_all_connections()
     }
 }
 
+// Indexed by MessageType
+static constexpr BrokenithmServer::Impl::MessageHandler MESSAGE_HANDLERS[MESSAGE_TYPE_COUNT] = {
+    &BrokenithmServer::Impl::ignore_message,      // MESSAGE_UNKNOWN
+    &BrokenithmServer::Impl::handle_binary_frame, // MESSAGE_BINARY_FRAME
+    &BrokenithmServer::Impl::handle_text_frame,   // MESSAGE_TEXT_FRAME
+    &BrokenithmServer::Impl::handle_ping,         // MESSAGE_PING
+    &BrokenithmServer::Impl::handle_sync,         // MESSAGE_SYNC
+    &BrokenithmServer::Impl::handle_heartbeat,    // MESSAGE_HEARTBEAT
+};
+
+void BrokenithmServer::Impl::handle_message(ConnectionData *connection, std::string_view message, bool binary, int64_t receive_time)
+{
+    connection->m_last_receive_time = receive_time;
+    if (connection->m_silent)
+    {
+        connection->m_silent = false;
+        if (connection->m_released)
+        {
+            // The page only sends frames when touches change, ask for the lanes still held
+            connection->m_released = false;
+            connection->m_websocket->send(FRAME_REQUEST, uWS::TEXT);
+        }
+    }
+
+    // Binary messages are only ever input frames and input frames only ever binary
+    MessageType type = message_type_table(message);
+    if (binary != (type == MESSAGE_BINARY_FRAME))
+    {
+        if (binary)
+        {
+            m_metrics.m_invalid_frames.fetch_add(1, std::memory_order_relaxed);
+            if (m_recorder)
+            {
+                m_recorder->record(SessionRecordHeader::RECORD_BINARY_FRAME, -1, connection->m_uid, receive_time, 0, message);
+            }
+        }
+        return;
+    }
+
+    (this->*MESSAGE_HANDLERS[type])(connection, message, receive_time);
+}
+
+void BrokenithmServer::Impl::ignore_message(ConnectionData * /*connection*/, std::string_view /*message*/, int64_t /*receive_time*/)
+{
+}
+
+void BrokenithmServer::Impl::handle_binary_frame(ConnectionData *connection, std::string_view message, int64_t receive_time)
+{
+    InputFrame frame;
+    int slot = -1;
+    int64_t touch_time = 0;
+    if (!parse_binary_frame(message, frame))
+    {
+        m_metrics.m_invalid_frames.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (connection->m_slot >= 0 && connection->accept_frame(frame, m_metrics))
+    {
+        slot = connection->m_slot;
+        touch_time = connection->touch_time(frame, receive_time, m_metrics);
+        m_controller_state.update(slot, frame.m_buttons, receive_time, touch_time);
+        m_metrics.m_receive_to_publish.record(now_nanos() - receive_time);
+    }
+
+    // After publishing, so recording never delays a key
+    if (m_recorder)
+    {
+        m_recorder->record(SessionRecordHeader::RECORD_BINARY_FRAME, slot, connection->m_uid, receive_time, touch_time, message);
+    }
+}
+
+void BrokenithmServer::Impl::handle_text_frame(ConnectionData *connection, std::string_view message, int64_t receive_time)
+{
+    InputFrame frame;
+    int slot = -1;
+    if (parse_text_frame(message, frame) && connection->m_slot >= 0 && connection->accept_frame(frame, m_metrics))
+    {
+        slot = connection->m_slot;
+        m_controller_state.update(slot, frame.m_buttons, receive_time, 0);
+        m_metrics.m_receive_to_publish.record(now_nanos() - receive_time);
+    }
+
+    if (m_recorder)
+    {
+        m_recorder->record(SessionRecordHeader::RECORD_TEXT_FRAME, slot, connection->m_uid, receive_time, 0, message);
+    }
+}
+
+void BrokenithmServer::Impl::handle_ping(ConnectionData *connection, std::string_view message, int64_t receive_time)
+{
+    if (message.substr(0, 6) != "alive?")
+    {
+        return;
+    }
+
+    connection->m_websocket->send(ALIVE_REPLY, uWS::TEXT);
+    connection->receive_ping(message);
+    if (!connection->m_sync_sent_time || receive_time - connection->m_sync_sent_time > SYNC_TIMEOUT_NANOS)
+    {
+        connection->send_sync();
+    }
+}
+
+void BrokenithmServer::Impl::handle_sync(ConnectionData *connection, std::string_view message, int64_t receive_time)
+{
+    if (message.substr(0, 4) == "sync")
+    {
+        connection->receive_sync(message, receive_time);
+    }
+}
+
+void BrokenithmServer::Impl::handle_heartbeat(ConnectionData *connection, std::string_view message, int64_t /*receive_time*/)
+{
+    if (message == "h")
+    {
+        connection->m_heartbeat = true;
+    }
+}
+
+// Sends a preloaded asset as one status line plus headers and a single tryEnd,
+// only registering callbacks when the socket pushes back
+template <bool SSL>
+static void serve_asset(uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, const std::shared_ptr<const StaticAssets> &assets)
+{
+    const StaticAsset *asset = assets->find(req->getUrl());
+    if (!asset)
+    {
+        res->writeStatus("404 Not Found");
+        res->end();
+        return;
+    }
+
+    StaticAsset::Encoding encoding = asset->select(StaticAssets::accepted_encodings(req->getHeader("accept-encoding")));
+    if (asset->not_modified(encoding, req->getHeader("if-none-match")))
+    {
+        res->writeStatus(asset->m_not_modified_head[encoding]);
+        res->endWithoutBody();
+        return;
+    }
+
+    std::string_view body = asset->m_body[encoding];
+    res->writeStatus(asset->m_head[encoding]);
+    if (!res->tryEnd(body).first && !res->hasResponded())
+    {
+        // Holding on to the asset set keeps body valid across a reload
+        res->onWritable([res, body, assets](size_t offset) {
+               return res->tryEnd(body.substr(offset), body.size()).first;
+           })->onAborted([]() {});
+    }
+}
+
 BrokenithmServer::Impl::Impl(int port) : m_port(port),
                                          m_uws_loop(nullptr),
                                          m_uws_socket_token(nullptr),
                                          m_thread(),
-                                         m_running(false){};
+                                         m_running(false),
+                                         m_low_latency_sockets(false),
+                                         m_busy_poll_loop(false),
+                                         m_recorder(nullptr),
+                                         m_layout_lanes(4),
+                                         m_layout_air_lanes(0),
+                                         m_heartbeat_deadline_millis(0),
+                                         m_heartbeat_timer(nullptr),
+                                         m_slot_connections(){};
 
 BrokenithmServer::Impl::~Impl()
 {
-    if (m_running)
+    if (m_running || m_thread.joinable())
     {
         stop_server();
     }
 }
 
-void BrokenithmServer::Impl::start_server_async()
+bool BrokenithmServer::Impl::start_server_async()
 {
+    m_started = std::promise<bool>();
+    std::future<bool> started = m_started.get_future();
     m_thread = std::thread([&] { start_server(); });
+    return started.get();
 }
 
 void BrokenithmServer::Impl::start_server()
 {
     spdlog::info("Starting server...");
 
-    AsyncFileStreamer asyncFileStreamer("res/www/");
+    apply_thread_tuning("Server", m_thread_tuning);
+    log_thread_stats("Server");
+
+    m_asset_root = (std::filesystem::path(get_executable_directory()) / ASSET_DIRECTORY).string();
+    std::shared_ptr<StaticAssets> assets = std::make_shared<StaticAssets>();
+    if (!assets->load(m_asset_root))
+    {
+        spdlog::error("Cannot start the server without its web assets");
+        m_started.set_value(false);
+        return;
+    }
+    spdlog::info("Loaded {} web assets ({} bytes, {} from {})", assets->m_assets.size(), assets->size(), assets->m_overridden, m_asset_root);
+    m_assets = assets;
 
     m_uws_loop = uWS::Loop::get();
+    watch_assets();
+
+    if (m_controller_state.m_merge_policy == ControllerState::MERGE_LANES)
+    {
+        m_layout_message = fmt::format("layout{},0", m_controller_state.m_device_lanes);
+    }
+    else
+    {
+        m_layout_message = fmt::format("layout{},{}", m_layout_lanes, m_layout_air_lanes);
+    }
+
+    if (m_low_latency_sockets)
+    {
+        // SO_BUSY_POLL above net.core.busy_read needs CAP_NET_ADMIN, the rest works unprivileged
+        us_low_latency_options_t options = {};
+        options.busy_poll_micros = LOW_LATENCY_BUSY_POLL_MICROS;
+        options.buffer_size = LOW_LATENCY_BUFFER_SIZE;
+        options.tos = LOW_LATENCY_TOS;
+        options.quickack = 1;
+        us_socket_low_latency(&options);
+        spdlog::info("Low latency sockets, {} us busy poll, {} byte buffers", LOW_LATENCY_BUSY_POLL_MICROS, LOW_LATENCY_BUFFER_SIZE);
+    }
+    if (m_busy_poll_loop)
+    {
+        us_loop_busy_poll((us_loop_t *)m_uws_loop, 1);
+        spdlog::info("Server thread busy polls the {} event loop", event_loop());
+    }
+
+    // Runs once per pass through the loop, before any socket is handled
+    ((uWS::Loop *)m_uws_loop)->addPreHandler(this, [this](uWS::Loop *) {
+        m_metrics.m_loop_wakeups.fetch_add(1, std::memory_order_relaxed);
+    });
 
     uWS::App()
         .get(
-            "/",
-            [&asyncFileStreamer](auto *res, auto *req) {
-                res->writeStatus(uWS::HTTP_200_OK);
-                asyncFileStreamer.streamFile<false>(res, "index.html");
-            })
-        .get(
-            "/config.js",
-            [&asyncFileStreamer](auto *res, auto *req) {
-                res->writeStatus(uWS::HTTP_200_OK);
-                asyncFileStreamer.streamFile<false>(res, "config.js");
-            })
-        .get(
-            "/app.js",
-            [&asyncFileStreamer](auto *res, auto *req) {
+            "/metrics",
+            [&](auto *res, auto * /*req*/) {
+                std::string body;
+                render_metrics(body);
                 res->writeStatus(uWS::HTTP_200_OK);
-                asyncFileStreamer.streamFile<false>(res, "app.js");
+                res->writeHeader("Content-Type", "text/plain; version=0.0.4");
+                res->end(body);
             })
+        // Anything not matched by a more specific route is a file under res/www
         .get(
-            "/favicon.ico",
-            [&asyncFileStreamer](auto *res, auto *req) {
-                res->writeStatus(uWS::HTTP_200_OK);
-                asyncFileStreamer.streamFile<false>(res, "favicon.ico");
+            "/*",
+            [&](auto *res, auto *req) {
+                serve_asset(res, req, m_assets);
             })
         .ws<ConnectionData>(
             "/ws",
@@ -162,59 +647,228 @@ void BrokenithmServer::Impl::start_server()
              0,                // maxLifetime
              nullptr,          // upgrade
              // Open handler
-             [](auto *ws) {
-                 spdlog::info("Controller ID {} connected", ((ConnectionData *)ws->getUserData())->m_uid);
-                 ((ConnectionData *)ws->getUserData())->save_socket(ws);
+             [&](auto *ws) {
+                 ConnectionData *connection = (ConnectionData *)ws->getUserData();
+                 connection->save_socket(ws);
+                 connection->m_slot = m_controller_state.acquire_slot();
+                 if (connection->m_slot < 0)
+                 {
+                     spdlog::warn("Controller ID {} connected, but all {} controller slots are in use", connection->m_uid, m_controller_state.slot_count());
+                 }
+                 else
+                 {
+                     m_slot_connections[connection->m_slot] = connection;
+                     spdlog::info("Controller ID {} connected in slot {}", connection->m_uid, connection->m_slot);
+                 }
+                 if (m_recorder)
+                 {
+                     m_recorder->record(SessionRecordHeader::RECORD_OPEN, connection->m_slot, connection->m_uid, now_nanos(), 0, {});
+                 }
+                 ws->send(m_layout_message, uWS::TEXT);
+                 if (!m_heartbeat_message.empty())
+                 {
+                     ws->send(m_heartbeat_message, uWS::TEXT);
+                 }
+                 connection->m_last_receive_time = now_nanos();
+                 connection->send_sync();
              },
              // Message handler
              [&](auto *ws, std::string_view message, uWS::OpCode opCode) {
-                 if (opCode == uWS::TEXT)
-                 {
-                     if (message.size() == 5 && message[0] == 'b')
-                     {
-                         m_controller_state.start();
-
-                         for (int i = 0; i < 4; i++)
-                         {
-                             if (message[i+1] == '1')
-                             {
-                                 m_controller_state.add_button(i);
-                             }
-                         }
-                         m_controller_state.end();
-                     }
-                     else if (message == "alive?")
-                     {
-                         ws->send("alive", uWS::TEXT);
-                     }
-                 }
+                 int64_t receive_time = now_nanos();
+                 handle_message((ConnectionData *)ws->getUserData(), message, opCode == uWS::BINARY, receive_time);
              },
              nullptr, // Drain handler
              nullptr, // Ping handler
              nullptr, // Pong handler
              // Close handler
-             [](auto *ws, int code, std::string_view message) {
-                 spdlog::info("Controller ID {} disconnected", ((ConnectionData *)ws->getUserData())->m_uid);
+             [&](auto *ws, int /*code*/, std::string_view /*message*/) {
+                 ConnectionData *connection = (ConnectionData *)ws->getUserData();
+                 spdlog::info("Controller ID {} disconnected ({} frames, {} duplicate, {} out of order, {} skipped)",
+                              connection->m_uid,
+                              connection->m_frames,
+                              connection->m_duplicate_frames,
+                              connection->m_reordered_frames,
+                              connection->m_skipped_frames);
+                 if (m_recorder)
+                 {
+                     m_recorder->record(SessionRecordHeader::RECORD_CLOSE, connection->m_slot, connection->m_uid, now_nanos(), 0, {});
+                 }
+                 if (connection->m_slot >= 0)
+                 {
+                     m_slot_connections[connection->m_slot] = nullptr;
+                     m_controller_state.release_slot(connection->m_slot);
+                     connection->m_slot = -1;
+                 }
              }})
         .listen(m_port, [&](auto *token) {
             if (token)
             {
-                spdlog::info("Server listening at port {}", m_port);
+                spdlog::info("Server listening at port {} ({} event loop)", m_port, event_loop());
                 m_running = true;
                 m_uws_socket_token = token;
+                start_heartbeat_timer();
+                m_started.set_value(true);
+            }
+            else
+            {
+                spdlog::error("Cannot listen at port {}", m_port);
+                // Nothing else may keep the loop running
+                m_asset_watcher.reset();
             }
         })
         .run();
 
+    log_thread_stats("Server");
+    if (!m_running)
+    {
+        // The loop is gone with this thread, stop_server must not defer onto it
+        m_uws_loop = nullptr;
+        m_started.set_value(false);
+    }
     m_running = false;
 }
 
+void BrokenithmServer::Impl::watch_assets()
+{
+    // Rebuilding happens on the watcher thread, the loop only swaps a pointer.
+    // Responses still draining keep the set they started with alive.
+    uWS::Loop *loop = (uWS::Loop *)m_uws_loop;
+    std::shared_ptr<const StaticAssets> latest = m_assets;
+    std::error_code error;
+    if (!std::filesystem::is_directory(m_asset_root, error))
+    {
+        spdlog::info("No {} directory, serving built in web assets only", m_asset_root);
+        return;
+    }
+
+    m_asset_watcher = std::make_unique<DirectoryWatcher>(m_asset_root, [this, loop, latest]() mutable {
+        std::shared_ptr<StaticAssets> next = std::make_shared<StaticAssets>();
+        if (!next->load(m_asset_root, latest.get()))
+        {
+            spdlog::warn("Keeping previous web assets");
+            return;
+        }
+        spdlog::info("Reloaded web assets, {} of {} files changed ({} bytes)", next->m_reloaded, next->m_assets.size(), next->size());
+
+        latest = next;
+        loop->defer([this, next] { m_assets = next; });
+    });
+}
+
+void BrokenithmServer::Impl::start_heartbeat_timer()
+{
+    if (m_heartbeat_deadline_millis <= 0)
+    {
+        return;
+    }
+    m_heartbeat_message = fmt::format("heartbeat{}", m_heartbeat_deadline_millis);
+
+    // Keeps the loop running like a socket would, stop_server closes it along with the listen socket
+    m_heartbeat_timer = us_create_timer((us_loop_t *)m_uws_loop, 0, sizeof(Impl *));
+    *(Impl **)us_timer_ext(m_heartbeat_timer) = this;
+    int interval = std::max(1, m_heartbeat_deadline_millis / HEARTBEAT_CHECKS_PER_DEADLINE);
+    us_timer_set(
+        m_heartbeat_timer, [](us_timer_t *timer) {
+            (*(Impl **)us_timer_ext(timer))->check_heartbeats();
+        },
+        interval, interval);
+    spdlog::info("Releasing the lanes of controllers silent for {} ms, checked every {} ms", m_heartbeat_deadline_millis, interval);
+}
+
+void BrokenithmServer::Impl::check_heartbeats()
+{
+    int64_t now = now_nanos();
+    int64_t deadline = m_heartbeat_deadline_millis * 1000000LL;
+    // Pages without a slot hold no lanes, there is nothing to release for them
+    uint64_t connected = m_controller_state.m_connected_slots.load(std::memory_order_relaxed);
+    while (connected)
+    {
+        int slot = lowest_bit(connected);
+        connected &= connected - 1;
+
+        ConnectionData *connection = m_slot_connections[slot];
+        if (connection == nullptr || !connection->m_heartbeat || connection->m_silent || now - connection->m_last_receive_time < deadline)
+        {
+            continue;
+        }
+
+        int64_t silence = now - connection->m_last_receive_time;
+        connection->m_silent = true;
+        m_metrics.m_heartbeat_detection.record(silence);
+
+        // Only this controller's lanes, the merge keeps whatever other controllers hold
+        if (!m_controller_state.m_slots[slot].m_buttons.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+        m_controller_state.update(slot, 0, now, 0);
+        connection->m_released = true;
+        m_metrics.m_forced_releases.fetch_add(1, std::memory_order_relaxed);
+        if (m_recorder)
+        {
+            m_recorder->record(SessionRecordHeader::RECORD_TIMEOUT, slot, connection->m_uid, now, 0, {});
+        }
+        spdlog::warn("Controller ID {} silent for {:.1f} ms, released its lanes", connection->m_uid, silence / 1e6);
+    }
+}
+
+void BrokenithmServer::Impl::render_metrics(std::string &out)
+{
+    m_metrics.render(out);
+
+    Metrics::render_value(out, "droidmaniac_edges_dropped_total", "counter", "Key edges dropped because the injector queue was full", static_cast<double>(m_controller_state.m_dropped_edges.load()));
+
+    int connections = 0;
+    std::string rtts;
+    std::string clocks;
+    std::string delays;
+    for (auto connection : ConnectionData::s_connections)
+    {
+        if (connection != nullptr)
+        {
+            connections++;
+            if (connection->m_clock.synced())
+            {
+                clocks += fmt::format("droidmaniac_connection_clock_offset_seconds{{id=\"{}\",slot=\"{}\"}} {:.6f}\n",
+                                      connection->m_uid,
+                                      connection->m_slot,
+                                      connection->m_clock.m_offset / 1e9);
+                delays += fmt::format("droidmaniac_connection_one_way_delay_seconds{{id=\"{}\",slot=\"{}\"}} {:.6f}\n",
+                                      connection->m_uid,
+                                      connection->m_slot,
+                                      connection->m_clock.m_delay / 1e9);
+            }
+            if (connection->m_rtt_micros >= 0)
+            {
+                rtts += fmt::format("droidmaniac_connection_rtt_seconds{{id=\"{}\",slot=\"{}\"}} {:.6f}\n",
+                                    connection->m_uid,
+                                    connection->m_slot,
+                                    connection->m_rtt_micros / 1e6);
+            }
+        }
+    }
+
+    Metrics::render_value(out, "droidmaniac_connections", "gauge", "Connected controllers", connections);
+    out += "# HELP droidmaniac_connection_rtt_seconds Round trip time of the controller liveness ping\n# TYPE droidmaniac_connection_rtt_seconds gauge\n";
+    out += rtts;
+    out += "# HELP droidmaniac_connection_clock_offset_seconds Server clock minus controller clock\n# TYPE droidmaniac_connection_clock_offset_seconds gauge\n";
+    out += clocks;
+    out += "# HELP droidmaniac_connection_one_way_delay_seconds Controller to server delay of the best recent clock sync exchange\n# TYPE droidmaniac_connection_one_way_delay_seconds gauge\n";
+    out += delays;
+}
+
 void BrokenithmServer::Impl::stop_server()
 {
     spdlog::info("Stopping server...");
     if (m_uws_loop)
     {
         ((uWS::Loop *)m_uws_loop)->defer([&] {
+            m_asset_watcher.reset();
+            if (m_heartbeat_timer)
+            {
+                us_timer_close(m_heartbeat_timer);
+                m_heartbeat_timer = nullptr;
+            }
             ConnectionData::close_all_connections();
             if (m_uws_socket_token)
             {
@@ -3,6 +3,9 @@
 #include <memory>
 
 #include "ControllerState.hpp"
+#include "Metrics.hpp"
+#include "SessionLog.hpp"
+#include "ThreadTuning.hpp"
 
 struct BrokenithmServer
 {
@@ -12,8 +15,31 @@ struct BrokenithmServer
     BrokenithmServer(int port);
     ~BrokenithmServer();
 
-    void start_server();
+    // Returns once the server listens, false if it could not start (logged). Call
+    // stop_server either way.
+    bool start_server();
     void stop_server();
 
+    void set_merge_policy(ControllerState::MergePolicy policy, int device_lanes);
+    // Lanes the controller page draws, the last air_lanes of them as air sensors.
+    // In lanes merge mode each controller draws its device lanes instead.
+    void set_layout(int lanes, int air_lanes);
+    // Applied by the server thread itself when it starts
+    void set_thread_tuning(const ThreadTuning &tuning);
+    // Low latency socket options (busy polling sockets, quick acks, small buffers, low delay TOS)
+    // and a network thread that spins on the event loop instead of sleeping
+    void set_low_latency(bool sockets, bool busy_poll_loop);
+    // Every input message and connection change is appended to recorder, which must outlive the server
+    void set_recorder(SessionRecorder *recorder);
+    // Release a controller's lanes once it has been silent this long, 0 leaves it to the
+    // WebSocket idle timeout. Only controller pages that send heartbeats are held to it.
+    void set_heartbeat_deadline(int millis);
+
     uint64_t get_controller_state();
+    ControllerState &get_controller();
+
+    Metrics &get_metrics();
+
+    // uSockets backend this was built with, epoll, kqueue or libuv
+    static const char *event_loop();
 };
@@ -0,0 +1,49 @@
+#include "ClockSync.hpp"
+
+ClockSync::ClockSync() : m_samples(),
+                         m_n_samples(0),
+                         m_next_sample(0),
+                         m_offset(0),
+                         m_delay(0) {}
+
+void ClockSync::add_sample(int64_t server_send_time, int64_t client_micros, int64_t server_receive_time)
+{
+    int64_t round_trip = server_receive_time - server_send_time;
+    if (round_trip < 0)
+    {
+        return;
+    }
+
+    Sample &sample = m_samples[m_next_sample];
+    sample.m_offset = server_send_time + round_trip / 2 - client_micros * 1000;
+    sample.m_delay = round_trip / 2;
+
+    m_next_sample = (m_next_sample + 1) % N_SAMPLES;
+    if (m_n_samples < N_SAMPLES)
+    {
+        m_n_samples++;
+    }
+
+    const Sample *best = &m_samples[0];
+    for (int i = 1; i < m_n_samples; i++)
+    {
+        if (m_samples[i].m_delay < best->m_delay)
+        {
+            best = &m_samples[i];
+        }
+    }
+    m_offset = best->m_offset;
+    m_delay = best->m_delay;
+}
+
+bool ClockSync::synced() const
+{
+    return m_n_samples > 0;
+}
+
+int64_t ClockSync::to_server_time(uint32_t client_micros, int64_t receive_time) const
+{
+    int64_t client_now = (receive_time - m_offset) / 1000;
+    int32_t wrap_delta = static_cast<int32_t>(client_micros - static_cast<uint32_t>(client_now));
+    return (client_now + wrap_delta) * 1000 + m_offset;
+}
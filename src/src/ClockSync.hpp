@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// NTP-style estimate of the offset between a controller's monotonic clock and ours.
+//
+// The server sends "sync?<server time>", the controller answers straight away with
+// "sync<server time>,<controller time>". Assuming the controller's timestamp sits
+// halfway through the round trip gives one offset sample; of the last N_SAMPLES the
+// one with the shortest round trip is trusted, since it had the least room for
+// queueing delay on either leg.
+struct ClockSync
+{
+    static constexpr int N_SAMPLES = 8;
+
+    struct Sample
+    {
+        int64_t m_offset; // server nanos - controller nanos
+        int64_t m_delay;  // half the round trip, nanos
+    };
+
+    std::array<Sample, N_SAMPLES> m_samples;
+    int m_n_samples;
+    int m_next_sample;
+
+    int64_t m_offset;
+    int64_t m_delay;
+
+    ClockSync();
+
+    void add_sample(int64_t server_send_time, int64_t client_micros, int64_t server_receive_time);
+
+    bool synced() const;
+
+    // Converts a wrapping 32-bit controller timestamp in microseconds to server nanos,
+    // using the receive time to pick the right wrap
+    int64_t to_server_time(uint32_t client_micros, int64_t receive_time) const;
+};
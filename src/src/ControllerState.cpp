@@ -1,19 +1,177 @@
 #include "ControllerState.hpp"
 
-ControllerState::ControllerState() : m_button_state(0),
-                                     m_button_state_staging(0) {}
+#include <algorithm>
+#include <chrono>
 
-void ControllerState::start()
+#include "spdlog/spdlog.h"
+
+#include "Bits.hpp"
+#include "Clock.hpp"
+
+ControllerState::ControllerState() : m_slots(),
+                                     m_connected_slots(0),
+                                     m_merge_policy(MERGE_OR),
+                                     m_device_lanes(4),
+                                     m_lanes(64),
+                                     m_sequence(0),
+                                     m_arrival_time(0),
+                                     m_edges(),
+                                     m_published_buttons(0),
+                                     m_dropped_edges(0),
+                                     m_resync(false) {}
+
+void ControllerState::set_merge_policy(MergePolicy policy, int device_lanes)
+{
+    m_merge_policy = policy;
+    m_device_lanes = device_lanes;
+}
+
+void ControllerState::set_lanes(int lanes)
+{
+    m_lanes = lanes;
+}
+
+int ControllerState::slot_count() const
+{
+    if (m_merge_policy != MERGE_LANES)
+    {
+        return MAX_CONTROLLERS;
+    }
+    return std::min(MAX_CONTROLLERS, (m_lanes + m_device_lanes - 1) / m_device_lanes);
+}
+
+int ControllerState::acquire_slot()
+{
+    // Slots are only handed out from the server thread, so a plain load is enough to pick one
+    int slots = slot_count();
+    uint64_t usable_slots = slots >= 64 ? ~0ULL : button_lookup_table(slots) - 1;
+    uint64_t free_slots = ~m_connected_slots.load() & usable_slots;
+    if (free_slots == 0)
+    {
+        if (slots < MAX_CONTROLLERS)
+        {
+            spdlog::warn("Lanes merge mode gives each controller {} lanes, the {} lane layout has none left for another", m_device_lanes, m_lanes);
+        }
+        return -1;
+    }
+
+    int slot = lowest_bit(free_slots);
+    m_slots[slot].m_buttons.store(0);
+    m_connected_slots.fetch_or(button_lookup_table(slot));
+    return slot;
+}
+
+void ControllerState::release_slot(int slot)
+{
+    m_connected_slots.fetch_and(~button_lookup_table(slot));
+    m_slots[slot].m_buttons.store(0);
+
+    // Wake the injector so the lanes this controller held are released
+    publish(now_nanos(), 0);
+}
+
+void ControllerState::update(int slot, uint64_t buttons, int64_t receive_time, int64_t touch_time)
+{
+    m_slots[slot].m_buttons.store(buttons);
+    publish(receive_time, touch_time);
+}
+
+void ControllerState::publish(int64_t receive_time, int64_t touch_time)
+{
+    int64_t now = now_nanos();
+
+    uint64_t merged = merge();
+    uint64_t changed = merged ^ m_published_buttons;
+    m_published_buttons = merged;
+    if (changed == 0)
+    {
+        return;
+    }
+
+    while (changed)
+    {
+        int lane = lowest_bit(changed);
+        changed &= changed - 1;
+
+        KeyEdge edge{touch_time, receive_time, now, lane, (merged & button_lookup_table(lane)) != 0};
+        if (!m_edges.push(edge))
+        {
+            // The injector fell behind, it will fall back to the merged state once it catches up
+            m_dropped_edges.fetch_add(1, std::memory_order_relaxed);
+            m_resync.store(true, std::memory_order_release);
+        }
+    }
+
+    m_arrival_time.store(now, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(m_notify_mutex);
+        m_sequence.fetch_add(1, std::memory_order_release);
+    }
+    m_notify_cv.notify_one();
+}
+
+uint64_t ControllerState::merge() const
+{
+    uint64_t connected = m_connected_slots.load();
+    if (connected == 0)
+    {
+        return 0;
+    }
+
+    if (m_merge_policy == MERGE_PRIMARY)
+    {
+        return m_slots[lowest_bit(connected)].m_buttons.load();
+    }
+
+    uint64_t lane_mask = m_device_lanes >= 64 ? ~0ULL : button_lookup_table(m_device_lanes) - 1;
+    uint64_t merged = 0;
+    while (connected)
+    {
+        int slot = lowest_bit(connected);
+        connected &= connected - 1;
+
+        uint64_t buttons = m_slots[slot].m_buttons.load();
+        if (m_merge_policy == MERGE_LANES)
+        {
+            int offset = slot * m_device_lanes;
+            if (offset >= 64)
+            {
+                break;
+            }
+            buttons = (buttons & lane_mask) << offset;
+        }
+        merged |= buttons;
+    }
+    return merged;
+}
+
+ControllerSnapshot ControllerState::snapshot() const
+{
+    ControllerSnapshot snapshot;
+    snapshot.m_sequence = m_sequence.load(std::memory_order_acquire);
+    snapshot.m_buttons = merge();
+    snapshot.m_arrival_time = m_arrival_time.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+ControllerSnapshot ControllerState::wait(uint64_t last_sequence, int millis_timeout)
 {
-    m_button_state_staging = 0;
+    {
+        std::unique_lock<std::mutex> lock(m_notify_mutex);
+        m_notify_cv.wait_for(lock, std::chrono::milliseconds(millis_timeout), [&] {
+            return m_sequence.load(std::memory_order_relaxed) != last_sequence;
+        });
+    }
+    return snapshot();
 }
 
-void ControllerState::add_button(int i)
+bool ControllerState::pop_edge(KeyEdge &edge)
 {
-    m_button_state_staging |= button_lookup_table(i);
+    return m_edges.pop(edge);
 }
 
-void ControllerState::end()
+bool ControllerState::take_resync()
 {
-    m_button_state.store(m_button_state_staging);
+    return m_resync.exchange(false, std::memory_order_acquire);
 }
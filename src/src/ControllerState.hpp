@@ -1,7 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <array>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include "SpscQueue.hpp"
 
 template <typename T>
 struct BitTable
@@ -24,14 +29,87 @@ struct BitTable
 
 static constexpr BitTable<uint64_t> button_lookup_table;
 
+struct ControllerSnapshot
+{
+    uint64_t m_buttons;
+    uint64_t m_sequence;
+    int64_t m_arrival_time;
+};
+
+// A single lane changing state, in the order the server received it
+struct KeyEdge
+{
+    int64_t m_touch_time; // 0 if the controller's clock is not synced
+    int64_t m_receive_time;
+    int64_t m_publish_time;
+    int m_lane;
+    bool m_pressed;
+};
+
+static constexpr size_t EDGE_QUEUE_SIZE = 1024;
+
+// Upper bound on simultaneously connected controllers, one bit each in m_connected_slots
+static constexpr int MAX_CONTROLLERS = 64;
+
+// Each controller writes its own cache line so connections never contend
+struct alignas(64) ControllerSlot
+{
+    std::atomic_uint64_t m_buttons;
+};
+
 struct ControllerState
 {
-    std::atomic_uint64_t m_button_state;
-    std::uint64_t m_button_state_staging;
+    enum MergePolicy
+    {
+        MERGE_OR,      // A lane is held while any controller holds it
+        MERGE_LANES,   // Controller n drives lanes [n * device_lanes, (n + 1) * device_lanes)
+        MERGE_PRIMARY, // Only the lowest connected slot drives the keys, others are standby
+    };
+
+    std::array<ControllerSlot, MAX_CONTROLLERS> m_slots;
+    std::atomic_uint64_t m_connected_slots;
+
+    MergePolicy m_merge_policy;
+    int m_device_lanes;
+    // Lanes of the keyboard layout, lanes merge mode hands out no slot that starts past them
+    int m_lanes;
+
+    // Bumped on every published change so the injector can tell new frames from old ones
+    std::atomic_uint64_t m_sequence;
+    std::atomic_int64_t m_arrival_time;
+
+    // Edges from the server thread to the injector, so taps shorter than a polling period survive
+    SpscQueue<KeyEdge, EDGE_QUEUE_SIZE> m_edges;
+    uint64_t m_published_buttons;
+    std::atomic_uint64_t m_dropped_edges;
+    std::atomic_bool m_resync;
+
+    std::mutex m_notify_mutex;
+    std::condition_variable m_notify_cv;
 
     ControllerState();
 
-    void start();
-    void end();
-    void add_button(int i);
+    void set_merge_policy(MergePolicy policy, int device_lanes);
+    void set_lanes(int lanes);
+
+    // Slots acquire_slot hands out, fewer than MAX_CONTROLLERS when lanes mode runs out of lanes
+    int slot_count() const;
+    // -1 if every usable slot is taken
+    int acquire_slot();
+    void release_slot(int slot);
+
+    // receive_time is when the frame was read off the socket, touch_time when the controller
+    // sampled it converted to our clock (0 if the controller's clock is unknown)
+    void update(int slot, uint64_t buttons, int64_t receive_time, int64_t touch_time);
+
+    uint64_t merge() const;
+
+    ControllerSnapshot snapshot() const;
+    ControllerSnapshot wait(uint64_t last_sequence, int millis_timeout);
+
+    bool pop_edge(KeyEdge &edge);
+    bool take_resync();
+
+private:
+    void publish(int64_t receive_time, int64_t touch_time);
 };
@@ -0,0 +1,274 @@
+#include "DirectoryWatcher.hpp"
+
+#include "spdlog/spdlog.h"
+
+// Editors often save through several writes or a rename, wait this long for quiet
+static const int SETTLE_MILLIS = 100;
+
+enum WaitResult
+{
+    WAIT_CHANGED,
+    WAIT_TIMEOUT,
+    WAIT_STOPPED,
+};
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+struct DirectoryWatcher::Impl
+{
+    HANDLE m_directory;
+    HANDLE m_stop;
+    OVERLAPPED m_overlapped;
+    bool m_pending;
+    alignas(DWORD) char m_buffer[16 * 1024];
+
+    Impl() : m_directory(INVALID_HANDLE_VALUE),
+             m_stop(CreateEventW(nullptr, TRUE, FALSE, nullptr)),
+             m_overlapped(),
+             m_pending(false)
+    {
+        m_overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    }
+
+    ~Impl()
+    {
+        if (m_directory != INVALID_HANDLE_VALUE)
+        {
+            if (m_pending)
+            {
+                CancelIo(m_directory);
+                DWORD transferred;
+                GetOverlappedResult(m_directory, &m_overlapped, &transferred, TRUE);
+            }
+            CloseHandle(m_directory);
+        }
+        CloseHandle(m_overlapped.hEvent);
+        CloseHandle(m_stop);
+    }
+
+    bool open(const std::string &root)
+    {
+        m_directory = CreateFileA(root.c_str(),
+                                  FILE_LIST_DIRECTORY,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                  nullptr);
+        return m_directory != INVALID_HANDLE_VALUE && m_overlapped.hEvent && m_stop;
+    }
+
+    WaitResult wait(int millis)
+    {
+        if (!m_pending)
+        {
+            ResetEvent(m_overlapped.hEvent);
+            if (!ReadDirectoryChangesW(m_directory,
+                                       m_buffer,
+                                       sizeof(m_buffer),
+                                       TRUE,
+                                       FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+                                       nullptr,
+                                       &m_overlapped,
+                                       nullptr))
+            {
+                return WAIT_STOPPED;
+            }
+            m_pending = true;
+        }
+
+        HANDLE handles[] = {m_stop, m_overlapped.hEvent};
+        DWORD result = WaitForMultipleObjects(2, handles, FALSE, millis < 0 ? INFINITE : static_cast<DWORD>(millis));
+        if (result == WAIT_TIMEOUT)
+        {
+            return WAIT_TIMEOUT;
+        }
+        if (result != WAIT_OBJECT_0 + 1)
+        {
+            return WAIT_STOPPED;
+        }
+
+        // The change list itself is not needed, the reload compares file times.
+        // An overflowed buffer still means something changed.
+        DWORD transferred;
+        GetOverlappedResult(m_directory, &m_overlapped, &transferred, FALSE);
+        m_pending = false;
+        return WAIT_CHANGED;
+    }
+
+    void stop()
+    {
+        SetEvent(m_stop);
+    }
+};
+
+#elif defined(__linux__)
+
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <filesystem>
+
+struct DirectoryWatcher::Impl
+{
+    std::string m_root;
+    int m_inotify;
+    int m_stop;
+    alignas(inotify_event) char m_buffer[16 * 1024];
+
+    Impl() : m_root(),
+             m_inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+             m_stop(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+    ~Impl()
+    {
+        if (m_inotify >= 0)
+        {
+            close(m_inotify);
+        }
+        if (m_stop >= 0)
+        {
+            close(m_stop);
+        }
+    }
+
+    // inotify is not recursive, so every directory gets its own watch
+    bool add_watches()
+    {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+        if (inotify_add_watch(m_inotify, m_root.c_str(), mask) < 0)
+        {
+            return false;
+        }
+
+        std::error_code error;
+        for (std::filesystem::recursive_directory_iterator it(m_root, error), end; !error && it != end; it.increment(error))
+        {
+            if (it->is_directory(error))
+            {
+                inotify_add_watch(m_inotify, it->path().c_str(), mask);
+            }
+        }
+        return true;
+    }
+
+    bool open(const std::string &root)
+    {
+        m_root = root;
+        return m_inotify >= 0 && m_stop >= 0 && add_watches();
+    }
+
+    WaitResult wait(int millis)
+    {
+        pollfd fds[] = {{m_stop, POLLIN, 0}, {m_inotify, POLLIN, 0}};
+        int result = poll(fds, 2, millis);
+        if (result == 0)
+        {
+            return WAIT_TIMEOUT;
+        }
+        if (result < 0 || fds[0].revents)
+        {
+            return result < 0 && errno == EINTR ? WAIT_TIMEOUT : WAIT_STOPPED;
+        }
+
+        bool new_directory = false;
+        ssize_t length;
+        while ((length = read(m_inotify, m_buffer, sizeof(m_buffer))) > 0)
+        {
+            for (char *p = m_buffer; p < m_buffer + length;)
+            {
+                inotify_event *event = reinterpret_cast<inotify_event *>(p);
+                new_directory |= (event->mask & (IN_CREATE | IN_MOVED_TO)) && (event->mask & IN_ISDIR);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (new_directory)
+        {
+            add_watches();
+        }
+        return WAIT_CHANGED;
+    }
+
+    void stop()
+    {
+        uint64_t one = 1;
+        ssize_t written = write(m_stop, &one, sizeof(one));
+        (void)written;
+    }
+};
+
+#else
+
+struct DirectoryWatcher::Impl
+{
+    bool open(const std::string &root)
+    {
+        return false;
+    }
+
+    WaitResult wait(int millis)
+    {
+        return WAIT_STOPPED;
+    }
+
+    void stop() {}
+};
+
+#endif
+
+DirectoryWatcher::DirectoryWatcher(const std::string &root, std::function<void()> on_change)
+    : m_impl(std::make_unique<Impl>()),
+      m_on_change(std::move(on_change)),
+      m_thread()
+{
+    if (!m_impl->open(root))
+    {
+        spdlog::warn("Cannot watch {} for changes, restart to pick up edits", root);
+        return;
+    }
+    m_thread = std::thread([this] { run(); });
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    if (m_thread.joinable())
+    {
+        m_impl->stop();
+        m_thread.join();
+    }
+}
+
+bool DirectoryWatcher::watching() const
+{
+    return m_thread.joinable();
+}
+
+void DirectoryWatcher::run()
+{
+    while (true)
+    {
+        WaitResult result = m_impl->wait(-1);
+        if (result == WAIT_STOPPED)
+        {
+            return;
+        }
+        if (result == WAIT_TIMEOUT)
+        {
+            continue;
+        }
+
+        while ((result = m_impl->wait(SETTLE_MILLIS)) == WAIT_CHANGED)
+        {
+        }
+        if (result == WAIT_STOPPED)
+        {
+            return;
+        }
+        m_on_change();
+    }
+}
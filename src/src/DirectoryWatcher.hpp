@@ -0,0 +1,26 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Watches a directory tree (inotify on Linux, ReadDirectoryChangesW on Windows)
+// and calls back on its own thread once a burst of changes has settled
+struct DirectoryWatcher
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    std::function<void()> m_on_change;
+    std::thread m_thread;
+
+    DirectoryWatcher(const std::string &root, std::function<void()> on_change);
+    ~DirectoryWatcher();
+
+    // False if the OS refused to watch the directory
+    bool watching() const;
+
+private:
+    void run();
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+// A file from res/www compiled into the executable by cmake/EmbedAssets.cmake
+struct EmbeddedAsset
+{
+    const char *m_url;
+    const unsigned char *m_data;
+    size_t m_size;
+    const unsigned char *m_gzip; // nullptr unless compressed at build time
+    size_t m_gzip_size;
+};
+
+// Sorted by URL, defined in the generated EmbeddedAssets.cpp
+extern const EmbeddedAsset EMBEDDED_ASSETS[];
+extern const size_t EMBEDDED_ASSET_COUNT;
@@ -0,0 +1,217 @@
+#include "Injector.hpp"
+
+#include <algorithm>
+
+#include "Bits.hpp"
+#include "Clock.hpp"
+
+// Idle wakeups, so shutdown and stats are not held up by a quiet controller
+static constexpr int IDLE_TIMEOUT_MILLIS = 100;
+
+// Scheduled edges closer than this are left to the precision timer instead of the condition variable,
+// which cannot be woken early but is far more accurate
+static constexpr int64_t TIMER_NANOS = 2000000;
+
+Injector::Injector(ControllerState &controller_state, KeyboardSimulator &keyboard, Metrics &metrics, DispatchMode mode, bool dryrun)
+    : m_controller_state(controller_state),
+      m_keyboard(keyboard),
+      m_metrics(metrics),
+      m_mode(mode),
+      m_schedule_delay(0),
+      m_dryrun(dryrun),
+      m_timer(),
+      m_poll_period(10000000),
+      m_next_poll_time(0),
+      m_poll_start_time(0),
+      m_last_poll_time(0),
+      m_polls(0),
+      m_last_sequence(0),
+      m_batch(),
+      m_sample_period(0),
+      m_sample_edges(0),
+      m_sample_toggled(0),
+      m_scheduled(),
+      m_last_due_time(0)
+{
+    m_batch.reserve(EDGE_QUEUE_SIZE);
+}
+
+void Injector::set_poll_frequency(int frequency)
+{
+    m_poll_period = 1000000000LL / frequency;
+}
+
+void Injector::set_schedule_delay(int millis)
+{
+    m_schedule_delay = millis * 1000000LL;
+    m_metrics.m_schedule_delay.store(m_schedule_delay, std::memory_order_relaxed);
+}
+
+double Injector::poll_rate() const
+{
+    int64_t elapsed = m_last_poll_time - m_poll_start_time;
+    return elapsed > 0 && m_polls > 1 ? (m_polls - 1) * 1e9 / elapsed : 0;
+}
+
+void Injector::run_once()
+{
+    if (m_mode == DISPATCH_SCHEDULED)
+    {
+        run_scheduled();
+    }
+    else
+    {
+        run_immediate();
+    }
+}
+
+void Injector::run_immediate()
+{
+    if (m_mode == DISPATCH_EVENT)
+    {
+        m_last_sequence = m_controller_state.wait(m_last_sequence, IDLE_TIMEOUT_MILLIS).m_sequence;
+    }
+    else
+    {
+        if (m_polls == 0)
+        {
+            m_poll_start_time = m_next_poll_time = now_nanos();
+        }
+
+        m_metrics.m_timer_overshoot.record(m_timer.sleep_until(m_next_poll_time));
+        m_last_poll_time = now_nanos();
+        m_polls++;
+
+        // Skip missed periods instead of bursting to catch up
+        m_next_poll_time += m_poll_period;
+        if (m_next_poll_time < m_last_poll_time)
+        {
+            m_next_poll_time += (m_last_poll_time - m_next_poll_time) / m_poll_period * m_poll_period + m_poll_period;
+        }
+    }
+
+    bool resync = m_controller_state.take_resync();
+
+    KeyEdge edge;
+    m_batch.clear();
+    while (m_controller_state.pop_edge(edge))
+    {
+        m_batch.push_back(edge);
+    }
+
+    if (!m_batch.empty() || resync)
+    {
+        inject(m_batch, resync);
+    }
+}
+
+void Injector::run_scheduled()
+{
+    bool resync = m_controller_state.take_resync();
+
+    KeyEdge edge;
+    int64_t now = now_nanos();
+    while (m_controller_state.pop_edge(edge))
+    {
+        // Without a synced controller clock the best reference is when the frame arrived
+        int64_t reference = edge.m_touch_time ? edge.m_touch_time : edge.m_receive_time;
+        int64_t due_time = std::max(reference + m_schedule_delay, m_last_due_time);
+        m_last_due_time = due_time;
+
+        if (due_time < now)
+        {
+            m_metrics.m_late_edges.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_scheduled.push_back({due_time, edge});
+    }
+
+    if (resync)
+    {
+        // Edges were lost, give up on the schedule and jump to the current state
+        m_batch.clear();
+        for (const ScheduledEdge &scheduled : m_scheduled)
+        {
+            m_batch.push_back(scheduled.m_edge);
+        }
+        m_scheduled.clear();
+        inject(m_batch, true);
+        return;
+    }
+
+    if (m_scheduled.empty())
+    {
+        m_last_sequence = m_controller_state.wait(m_last_sequence, IDLE_TIMEOUT_MILLIS).m_sequence;
+        return;
+    }
+
+    int64_t due_time = m_scheduled.front().m_due_time;
+    if (due_time - now > TIMER_NANOS)
+    {
+        // Sleep until close to the deadline, but wake up to schedule newly published edges
+        int millis = static_cast<int>(std::min<int64_t>((due_time - now - TIMER_NANOS) / 1000000 + 1, IDLE_TIMEOUT_MILLIS));
+        m_last_sequence = m_controller_state.wait(m_last_sequence, millis).m_sequence;
+        return;
+    }
+
+    m_metrics.m_timer_overshoot.record(m_timer.sleep_until(due_time));
+
+    now = now_nanos();
+    m_batch.clear();
+    while (!m_scheduled.empty() && m_scheduled.front().m_due_time <= now)
+    {
+        m_metrics.m_schedule_lateness.record(now - m_scheduled.front().m_due_time);
+        m_batch.push_back(m_scheduled.front().m_edge);
+        m_scheduled.pop_front();
+    }
+    inject(m_batch, false);
+}
+
+void Injector::inject(const std::vector<KeyEdge> &batch, bool resync)
+{
+    for (const KeyEdge &edge : batch)
+    {
+        if (!m_dryrun)
+        {
+            m_keyboard.send_edge(edge.m_lane, edge.m_pressed);
+        }
+    }
+
+    if (!m_dryrun)
+    {
+        m_keyboard.flush();
+        if (resync)
+        {
+            // Edges were dropped on a full queue, catch up to the current state instead
+            m_keyboard.send(m_controller_state.merge());
+        }
+    }
+
+    int64_t inject_time = now_nanos();
+    for (const KeyEdge &edge : batch)
+    {
+        m_metrics.m_publish_to_inject.record(inject_time - edge.m_publish_time);
+        m_metrics.m_receive_to_inject.record(inject_time - edge.m_receive_time);
+        if (edge.m_touch_time)
+        {
+            m_metrics.m_touch_to_inject.record(inject_time - edge.m_touch_time);
+        }
+        count_sampled_edge(edge);
+    }
+    m_metrics.m_edges_injected.fetch_add(batch.size(), std::memory_order_relaxed);
+}
+
+void Injector::count_sampled_edge(const KeyEdge &edge)
+{
+    // Edges arrive in receive order, so a later period means the previous one is complete.
+    // A sampler only sees lanes whose state changed over the period, every other edge is lost.
+    int64_t period = edge.m_receive_time / m_poll_period;
+    if (period != m_sample_period)
+    {
+        m_metrics.m_edges_saved.fetch_add(m_sample_edges - bit_count(m_sample_toggled), std::memory_order_relaxed);
+        m_sample_period = period;
+        m_sample_edges = 0;
+        m_sample_toggled = 0;
+    }
+    m_sample_edges++;
+    m_sample_toggled ^= button_lookup_table(edge.m_lane);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ControllerState.hpp"
+#include "KeyboardSimulator.hpp"
+#include "Metrics.hpp"
+#include "PrecisionTimer.hpp"
+
+// Moves key edges from ControllerState to the keyboard backend, runs on its own thread
+struct Injector
+{
+    enum DispatchMode
+    {
+        DISPATCH_EVENT,     // Inject as soon as an edge is published
+        DISPATCH_POLL,      // Inject everything published since the last polling period
+        DISPATCH_SCHEDULED, // Inject each edge a fixed delay after the controller sampled it
+    };
+
+    struct ScheduledEdge
+    {
+        int64_t m_due_time;
+        KeyEdge m_edge;
+    };
+
+    ControllerState &m_controller_state;
+    KeyboardSimulator &m_keyboard;
+    Metrics &m_metrics;
+
+    DispatchMode m_mode;
+    int64_t m_schedule_delay;
+    bool m_dryrun;
+
+    PrecisionTimer m_timer;
+
+    // Poll mode only, deadlines are absolute so the rate does not drift
+    int64_t m_poll_period;
+    int64_t m_next_poll_time;
+    int64_t m_poll_start_time;
+    int64_t m_last_poll_time;
+    uint64_t m_polls;
+
+    uint64_t m_last_sequence;
+    std::vector<KeyEdge> m_batch;
+
+    // Edges received in the latest polling period, to count what sampling the state once
+    // per period would have lost whatever the dispatch mode. The period is counted when
+    // an edge from a later one shows up, edges can still be queued until then.
+    int64_t m_sample_period;
+    uint64_t m_sample_edges;
+    uint64_t m_sample_toggled;
+
+    // Scheduled mode only, due times never decrease so edges keep their published order
+    std::deque<ScheduledEdge> m_scheduled;
+    int64_t m_last_due_time;
+
+    Injector(ControllerState &controller_state, KeyboardSimulator &keyboard, Metrics &metrics, DispatchMode mode, bool dryrun);
+
+    void set_poll_frequency(int frequency);
+    void set_schedule_delay(int millis);
+
+    // Polls per second actually achieved
+    double poll_rate() const;
+
+    // Waits for and injects one batch of edges, returns at least every 100 ms
+    void run_once();
+
+private:
+    void run_immediate();
+    void run_scheduled();
+
+    void inject(const std::vector<KeyEdge> &batch, bool resync);
+
+    void count_sampled_edge(const KeyEdge &edge);
+};
@@ -0,0 +1,82 @@
+#include "InputProtocol.hpp"
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool parse_binary_frame(std::string_view message, InputFrame &frame)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(message.data());
+    size_t size = message.size();
+
+    if (size < INPUT_FRAME_HEADER_SIZE || data[0] != INPUT_PROTOCOL_VERSION)
+    {
+        return false;
+    }
+
+    int lanes = data[1];
+    if (lanes < 1 || 64 < lanes)
+    {
+        return false;
+    }
+
+    size_t mask_size = (lanes + 7) / 8;
+    size_t remaining = size - INPUT_FRAME_HEADER_SIZE;
+    if (remaining != mask_size && remaining != mask_size + lanes)
+    {
+        return false;
+    }
+
+    uint64_t buttons = 0;
+    for (size_t i = 0; i < mask_size; i++)
+    {
+        buttons |= static_cast<uint64_t>(data[INPUT_FRAME_HEADER_SIZE + i]) << (i * 8);
+    }
+    if (lanes < 64)
+    {
+        buttons &= (1ULL << lanes) - 1;
+    }
+
+    frame.m_buttons = buttons;
+    frame.m_lanes = lanes;
+    frame.m_has_sequence = true;
+    frame.m_sequence = read_u16(data + 2);
+    frame.m_client_time = read_u32(data + 4);
+    frame.m_analog = remaining == mask_size ? nullptr : data + INPUT_FRAME_HEADER_SIZE + mask_size;
+    return true;
+}
+
+bool parse_text_frame(std::string_view message, InputFrame &frame)
+{
+    int lanes = static_cast<int>(message.size()) - 1;
+    if (lanes < 1 || 64 < lanes || message[0] != 'b')
+    {
+        return false;
+    }
+
+    uint64_t buttons = 0;
+    for (int i = 0; i < lanes; i++)
+    {
+        if (message[i + 1] == '1')
+        {
+            buttons |= 1ULL << i;
+        }
+    }
+
+    frame.m_buttons = buttons;
+    frame.m_lanes = lanes;
+    frame.m_has_sequence = false;
+    frame.m_sequence = 0;
+    frame.m_client_time = 0;
+    frame.m_analog = nullptr;
+    return true;
+}
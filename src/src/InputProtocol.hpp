@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Binary input frame sent by the controller page, all fields little-endian
+//
+//   offset  size        field
+//   0       1           protocol version (INPUT_PROTOCOL_VERSION)
+//   1       1           lane count N (1-64)
+//   2       2           frame sequence number, wraps at 65536
+//   4       4           client monotonic timestamp in microseconds, wraps
+//   8       ceil(N/8)   button bitmask, lane i is bit (i % 8) of byte (i / 8)
+//   ...     N           optional, one analog/position value per lane
+//
+// The legacy text frame "b0101" (one character per lane, 1-64 lanes) is still accepted.
+//
+// On connect the server tells the page which layout to draw with the text message
+// "layout<lanes>,<air lanes>", the last <air lanes> lanes being air sensors.
+//
+// With a heartbeat deadline the server also sends "heartbeat<milliseconds>", the
+// page then sends "h" several times per deadline. Once a page has sent one, going
+// silent for longer than the deadline releases its lanes, and the server asks for
+// the current state with "frame?" as soon as it hears from the page again.
+static constexpr uint8_t INPUT_PROTOCOL_VERSION = 1;
+static constexpr int INPUT_FRAME_HEADER_SIZE = 8;
+
+struct InputFrame
+{
+    uint64_t m_buttons;
+    int m_lanes;
+
+    // Legacy text frames carry neither a sequence number nor a timestamp
+    bool m_has_sequence;
+    uint16_t m_sequence;
+    uint32_t m_client_time;
+
+    // Points into the received message, nullptr when the frame has no analog data
+    const uint8_t *m_analog;
+};
+
+// What a WebSocket message carries, told apart by its first byte alone so the
+// server can jump straight to the right handler instead of trying each parser
+enum MessageType : uint8_t
+{
+    MESSAGE_UNKNOWN,
+    MESSAGE_BINARY_FRAME, // INPUT_PROTOCOL_VERSION, binary opcode only
+    MESSAGE_TEXT_FRAME,   // "b0101"
+    MESSAGE_PING,         // "alive?" optionally followed by the last round trip time
+    MESSAGE_SYNC,         // "sync<server time>,<controller time>"
+    MESSAGE_HEARTBEAT,    // "h"
+    MESSAGE_TYPE_COUNT,
+};
+
+struct MessageTypeTable
+{
+    MessageType x[256];
+
+    constexpr MessageTypeTable() : x()
+    {
+        x[INPUT_PROTOCOL_VERSION] = MESSAGE_BINARY_FRAME;
+        x['b'] = MESSAGE_TEXT_FRAME;
+        x['a'] = MESSAGE_PING;
+        x['s'] = MESSAGE_SYNC;
+        x['h'] = MESSAGE_HEARTBEAT;
+    }
+
+    inline MessageType operator()(std::string_view message) const
+    {
+        return message.empty() ? MESSAGE_UNKNOWN : x[static_cast<uint8_t>(message[0])];
+    }
+};
+
+static constexpr MessageTypeTable message_type_table;
+
+bool parse_binary_frame(std::string_view message, InputFrame &frame);
+bool parse_text_frame(std::string_view message, InputFrame &frame);
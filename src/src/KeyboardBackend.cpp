@@ -0,0 +1,49 @@
+#include "KeyboardBackend.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include "RecordingKeyboardBackend.hpp"
+
+#ifdef _WIN32
+std::unique_ptr<KeyboardBackend> create_sendinput_backend(const KeyboardLayout &layout);
+#endif
+
+#ifdef __linux__
+std::unique_ptr<KeyboardBackend> create_uinput_backend(const KeyboardLayout &layout);
+#endif
+
+std::vector<std::string> keyboard_backend_names()
+{
+    return {
+#ifdef _WIN32
+        "sendinput",
+#endif
+#ifdef __linux__
+        "uinput",
+#endif
+        "record",
+    };
+}
+
+std::unique_ptr<KeyboardBackend> create_keyboard_backend(const std::string &name, const KeyboardLayout &layout)
+{
+#ifdef _WIN32
+    if (name == "sendinput")
+    {
+        return create_sendinput_backend(layout);
+    }
+#endif
+#ifdef __linux__
+    if (name == "uinput")
+    {
+        return create_uinput_backend(layout);
+    }
+#endif
+    if (name == "record")
+    {
+        return std::make_unique<RecordingKeyboardBackend>(layout.lanes());
+    }
+
+    spdlog::error("Keyboard backend {} is not available on this platform", name);
+    return nullptr;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Keymap.hpp"
+
+// Destination for injected key events, lane i presses the layout's i-th scan code. key_down / key_up only buffer an event,
+// flush() hands everything buffered since the last flush to the OS as one batch.
+struct KeyboardBackend
+{
+    virtual ~KeyboardBackend() = default;
+
+    // Number of lanes the layout maps to keys
+    virtual int lanes() const = 0;
+
+    virtual void key_down(int i) = 0;
+    virtual void key_up(int i) = 0;
+    virtual void flush() = 0;
+};
+
+// Backends usable on this platform, the first one is the default
+std::vector<std::string> keyboard_backend_names();
+
+// Returns nullptr (after logging why) if the backend is unknown or cannot be opened
+std::unique_ptr<KeyboardBackend> create_keyboard_backend(const std::string &name, const KeyboardLayout &layout);
@@ -1,36 +1,23 @@
 #include "KeyboardSimulator.hpp"
 
-#include "spdlog/spdlog.h"
-
-#include <Windows.h>
-
-// https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
-
-static constexpr int N_BUTTONS = 4;
-
-WORD MANIA_BTN_MAP[N_BUTTONS] = {
-    'A', 'D', 'J', 'L'};
+#include "Bits.hpp"
 
 struct KeyboardSimulator::Impl
 {
-    WORD *m_layout;
-    INPUT m_input_buffer[N_BUTTONS];
+    std::unique_ptr<KeyboardBackend> m_backend;
+    int m_lanes;
+    uint64_t m_lane_mask;
 
     uint64_t m_last_keys;
-    int m_buffered_keys;
 
-    Impl(KeyboardSimulator::KeyboardSimulatorLayout layout);
-
-    void start();
-    void key_down(int i);
-    void key_up(int i);
-    void end();
+    Impl(std::unique_ptr<KeyboardBackend> backend);
 
     void send(uint64_t keys);
+    void send_edge(int i, bool pressed);
 };
 
-KeyboardSimulator::KeyboardSimulator(KeyboardSimulatorLayout layout)
-    : m_impl(std::make_unique<Impl>(layout)) {}
+KeyboardSimulator::KeyboardSimulator(std::unique_ptr<KeyboardBackend> backend)
+    : m_impl(std::make_unique<Impl>(std::move(backend))) {}
 
 KeyboardSimulator::~KeyboardSimulator() = default;
 
@@ -39,96 +26,70 @@ void KeyboardSimulator::send(uint64_t keys)
     m_impl->send(keys);
 }
 
-void KeyboardSimulator::delay(int millis)
+void KeyboardSimulator::send_edge(int lane, bool pressed)
 {
-    Sleep(millis);
+    m_impl->send_edge(lane, pressed);
 }
 
-KeyboardSimulator::Impl::Impl(KeyboardSimulator::KeyboardSimulatorLayout layout)
-    : m_layout(nullptr),
-      m_last_keys(0),
-      m_buffered_keys(0)
+void KeyboardSimulator::flush()
 {
-    switch (layout)
-    {
-    case LAYOUT_MANIA:
-        m_layout = MANIA_BTN_MAP;
-        break;
-    default:
-        m_layout = MANIA_BTN_MAP;
-        break;
-    }
+    m_impl->m_backend->flush();
+}
 
-    // Zero out buffer
-    for (int i = 0; i < N_BUTTONS; i++)
-    {
-        m_input_buffer[i].type = INPUT_KEYBOARD;
-        m_input_buffer[i].ki.wVk = 0;
-        m_input_buffer[i].ki.wScan = 0;
-        m_input_buffer[i].ki.dwFlags = 0;
-        m_input_buffer[i].ki.time = 0;
-        m_input_buffer[i].ki.dwExtraInfo = 0;
-    }
+KeyboardBackend &KeyboardSimulator::backend()
+{
+    return *m_impl->m_backend;
+}
 
-    // Send one blank keydown
-    start();
-    end();
+KeyboardSimulator::Impl::Impl(std::unique_ptr<KeyboardBackend> backend)
+    : m_backend(std::move(backend)),
+      m_lanes(0),
+      m_lane_mask(0),
+      m_last_keys(0)
+{
+    m_lanes = m_backend->lanes();
+    m_lane_mask = m_lanes >= 64 ? ~0ULL : (1ULL << m_lanes) - 1;
 };
 
 void KeyboardSimulator::Impl::send(uint64_t keys)
 {
+    // Only the lanes that changed are visited, so wide layouts cost no more than 4k
+    keys &= m_lane_mask;
     uint64_t keys_changed = keys ^ m_last_keys;
-    uint64_t keys_to_down = keys_changed & keys;
-    uint64_t keys_to_up = keys_changed & m_last_keys;
-
     m_last_keys = keys;
 
-    start();
-    for (int i = 0; i < N_BUTTONS; i++)
+    while (keys_changed)
     {
-        if (keys_to_down & 1)
+        int i = lowest_bit(keys_changed);
+        keys_changed &= keys_changed - 1;
+
+        if (keys & (1ULL << i))
         {
-            key_down(i);
+            m_backend->key_down(i);
         }
-        else if (keys_to_up & 1)
+        else
         {
-            key_up(i);
+            m_backend->key_up(i);
         }
-
-        keys_to_down >>= 1;
-        keys_to_up >>= 1;
     }
-    end();
-}
-
-void KeyboardSimulator::Impl::start()
-{
-    m_buffered_keys = 0;
-}
-
-void KeyboardSimulator::Impl::key_down(int i)
-{
-    spdlog::debug("{} Down", m_layout[i]);
-    m_input_buffer[m_buffered_keys].ki.wVk = m_layout[i];
-    m_input_buffer[m_buffered_keys].ki.dwFlags = 0;
-    m_buffered_keys++;
+    m_backend->flush();
 }
 
-void KeyboardSimulator::Impl::key_up(int i)
+void KeyboardSimulator::Impl::send_edge(int i, bool pressed)
 {
-    spdlog::debug("{} Up", m_layout[i]);
-    m_input_buffer[m_buffered_keys].ki.wVk = m_layout[i];
-    m_input_buffer[m_buffered_keys].ki.dwFlags = KEYEVENTF_KEYUP;
-    m_buffered_keys++;
-}
-
-using SendInputHandleType = UINT(WINAPI *)(UINT, LPINPUT, int);
-static SendInputHandleType SendInputHandle = reinterpret_cast<SendInputHandleType>(GetProcAddress(GetModuleHandleW((L"user32")), "SendInput"));
+    uint64_t bit = 1ULL << i;
+    if (i >= m_lanes || ((m_last_keys & bit) != 0) == pressed)
+    {
+        return;
+    }
 
-void KeyboardSimulator::Impl::end()
-{
-    if (m_buffered_keys)
+    if (pressed)
+    {
+        m_backend->key_down(i);
+    }
+    else
     {
-        SendInputHandle(m_buffered_keys, m_input_buffer, sizeof(INPUT));
+        m_backend->key_up(i);
     }
+    m_last_keys ^= bit;
 }
@@ -1,18 +1,20 @@
+#pragma once
+
 #include <memory>
 
+#include "KeyboardBackend.hpp"
+
 struct KeyboardSimulator
 {
-    enum KeyboardSimulatorLayout
-    {
-        LAYOUT_MANIA
-    };
-
     struct Impl;
     std::unique_ptr<Impl> m_impl;
 
-    KeyboardSimulator(KeyboardSimulatorLayout layout = LAYOUT_MANIA);
+    KeyboardSimulator(std::unique_ptr<KeyboardBackend> backend);
     ~KeyboardSimulator();
 
     void send(uint64_t keys);
-    void delay(int millis);
+    void send_edge(int lane, bool pressed);
+    void flush();
+
+    KeyboardBackend &backend();
 };
@@ -0,0 +1,229 @@
+#include "Keymap.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#include "spdlog/spdlog.h"
+
+struct KeyName
+{
+    const char *m_name;
+    uint16_t m_scan_code;
+};
+
+// https://learn.microsoft.com/en-us/windows/win32/inputdev/about-keyboard-input#scan-codes
+static const KeyName KEY_NAMES[] = {
+    {"ESC", 0x01}, {"1", 0x02}, {"2", 0x03}, {"3", 0x04}, {"4", 0x05}, {"5", 0x06}, {"6", 0x07},
+    {"7", 0x08}, {"8", 0x09}, {"9", 0x0A}, {"0", 0x0B}, {"-", 0x0C}, {"=", 0x0D}, {"BACKSPACE", 0x0E},
+    {"TAB", 0x0F}, {"Q", 0x10}, {"W", 0x11}, {"E", 0x12}, {"R", 0x13}, {"T", 0x14}, {"Y", 0x15},
+    {"U", 0x16}, {"I", 0x17}, {"O", 0x18}, {"P", 0x19}, {"[", 0x1A}, {"]", 0x1B}, {"ENTER", 0x1C},
+    {"LCTRL", 0x1D}, {"A", 0x1E}, {"S", 0x1F}, {"D", 0x20}, {"F", 0x21}, {"G", 0x22}, {"H", 0x23},
+    {"J", 0x24}, {"K", 0x25}, {"L", 0x26}, {";", 0x27}, {"'", 0x28}, {"`", 0x29}, {"LSHIFT", 0x2A},
+    {"\\", 0x2B}, {"Z", 0x2C}, {"X", 0x2D}, {"C", 0x2E}, {"V", 0x2F}, {"B", 0x30}, {"N", 0x31},
+    {"M", 0x32}, {",", 0x33}, {".", 0x34}, {"/", 0x35}, {"RSHIFT", 0x36}, {"KP*", 0x37}, {"LALT", 0x38},
+    {"SPACE", 0x39}, {"CAPSLOCK", 0x3A}, {"F1", 0x3B}, {"F2", 0x3C}, {"F3", 0x3D}, {"F4", 0x3E},
+    {"F5", 0x3F}, {"F6", 0x40}, {"F7", 0x41}, {"F8", 0x42}, {"F9", 0x43}, {"F10", 0x44},
+    {"NUMLOCK", 0x45}, {"SCROLLLOCK", 0x46}, {"KP7", 0x47}, {"KP8", 0x48}, {"KP9", 0x49}, {"KP-", 0x4A},
+    {"KP4", 0x4B}, {"KP5", 0x4C}, {"KP6", 0x4D}, {"KP+", 0x4E}, {"KP1", 0x4F}, {"KP2", 0x50},
+    {"KP3", 0x51}, {"KP0", 0x52}, {"KP.", 0x53}, {"F11", 0x57}, {"F12", 0x58},
+    {"KPENTER", 0xE01C}, {"RCTRL", 0xE01D}, {"KP/", 0xE035}, {"RALT", 0xE038}, {"HOME", 0xE047},
+    {"UP", 0xE048}, {"PAGEUP", 0xE049}, {"LEFT", 0xE04B}, {"RIGHT", 0xE04D}, {"END", 0xE04F},
+    {"DOWN", 0xE050}, {"PAGEDOWN", 0xE051}, {"INSERT", 0xE052}, {"DELETE", 0xE053},
+};
+
+struct BuiltInLayout
+{
+    const char *m_name;
+    const char *m_keys;
+    int m_air_lanes;
+};
+
+// osu!mania's default bindings, except 4k which keeps droidManiac's ADJL. Beyond 10k
+// the letter rows are used in order, "slider" is 16 Chunithm style slider cells plus 6 air sensors.
+static const BuiltInLayout BUILT_IN_LAYOUTS[] = {
+    {"4k", "A D J L", 0},
+    {"1k", "SPACE", 0},
+    {"2k", "F J", 0},
+    {"3k", "F SPACE J", 0},
+    {"5k", "D F SPACE J K", 0},
+    {"6k", "S D F J K L", 0},
+    {"7k", "S D F SPACE J K L", 0},
+    {"8k", "A S D F J K L ;", 0},
+    {"9k", "A S D F SPACE J K L ;", 0},
+    {"10k", "Q W E R V N U I O P", 0},
+    {"12k", "Q W E R T Y U I O P A S", 0},
+    {"14k", "Q W E R T Y U I O P A S D F", 0},
+    {"16k", "Q W E R T Y U I O P A S D F G H", 0},
+    {"18k", "Q W E R T Y U I O P A S D F G H J K", 0},
+    {"slider", "Q W E R T Y U I A S D F G H J K 1 2 3 4 5 6", 6},
+};
+
+// Lanes are bits of a 64-bit mask
+static constexpr int MAX_LAYOUT_LANES = 64;
+
+uint16_t scan_code(const std::string &name)
+{
+    std::string upper = name;
+    for (char &c : upper)
+    {
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+
+    for (const KeyName &key : KEY_NAMES)
+    {
+        if (upper == key.m_name)
+        {
+            return key.m_scan_code;
+        }
+    }
+    return 0;
+}
+
+const char *key_name(uint16_t scan_code)
+{
+    for (const KeyName &key : KEY_NAMES)
+    {
+        if (key.m_scan_code == scan_code)
+        {
+            return key.m_name;
+        }
+    }
+    return "?";
+}
+
+int KeyboardLayout::lanes() const
+{
+    return static_cast<int>(m_keys.size());
+}
+
+std::string KeyboardLayout::describe() const
+{
+    std::string text;
+    for (uint16_t key : m_keys)
+    {
+        if (!text.empty())
+        {
+            text += ' ';
+        }
+        text += key_name(key);
+    }
+    return text;
+}
+
+// Reads "<air lanes> <key> <key> ..." into layout, with error naming what is wrong
+static bool parse_layout(std::istringstream &stream, KeyboardLayout &layout, std::string &error)
+{
+    if (!(stream >> layout.m_air_lanes))
+    {
+        error = "expected the number of air lanes after the name";
+        return false;
+    }
+
+    std::string name;
+    while (stream >> name)
+    {
+        uint16_t key = scan_code(name);
+        if (key == 0)
+        {
+            error = fmt::format("unknown key {}", name);
+            return false;
+        }
+        layout.m_keys.push_back(key);
+    }
+
+    if (layout.m_keys.empty() || MAX_LAYOUT_LANES < layout.lanes())
+    {
+        error = fmt::format("{} keys, expected 1 to {}", layout.lanes(), MAX_LAYOUT_LANES);
+        return false;
+    }
+    if (layout.m_air_lanes < 0 || layout.lanes() < layout.m_air_lanes)
+    {
+        error = fmt::format("{} air lanes out of {} lanes", layout.m_air_lanes, layout.lanes());
+        return false;
+    }
+    return true;
+}
+
+static std::vector<KeyboardLayout> &layouts()
+{
+    static std::vector<KeyboardLayout> s_layouts = []
+    {
+        std::vector<KeyboardLayout> built_in;
+        for (const BuiltInLayout &entry : BUILT_IN_LAYOUTS)
+        {
+            KeyboardLayout layout;
+            layout.m_name = entry.m_name;
+            std::istringstream stream(std::to_string(entry.m_air_lanes) + ' ' + entry.m_keys);
+            std::string error;
+            parse_layout(stream, layout, error);
+            built_in.push_back(layout);
+        }
+        return built_in;
+    }();
+    return s_layouts;
+}
+
+const std::vector<KeyboardLayout> &keyboard_layouts()
+{
+    return layouts();
+}
+
+const KeyboardLayout *find_keyboard_layout(const std::string &name)
+{
+    for (const KeyboardLayout &layout : layouts())
+    {
+        if (name == layout.m_name)
+        {
+            return &layout;
+        }
+    }
+    return nullptr;
+}
+
+bool load_keymap_file(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        spdlog::error("Cannot open keymap file {}", path);
+        return false;
+    }
+
+    std::vector<KeyboardLayout> loaded;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+
+        std::istringstream stream(line);
+        KeyboardLayout layout;
+        if (!(stream >> layout.m_name) || layout.m_name[0] == '#')
+        {
+            continue;
+        }
+
+        std::string error;
+        if (!parse_layout(stream, layout, error))
+        {
+            spdlog::error("{}:{}: {}", path, line_number, error);
+            return false;
+        }
+        loaded.push_back(layout);
+    }
+
+    for (const KeyboardLayout &layout : loaded)
+    {
+        const KeyboardLayout *existing = find_keyboard_layout(layout.m_name);
+        if (existing)
+        {
+            layouts()[existing - layouts().data()] = layout;
+        }
+        else
+        {
+            layouts().push_back(layout);
+        }
+    }
+    return true;
+}
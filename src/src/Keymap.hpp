@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Keys are PC/AT set 1 scan codes, the physical key whatever keyboard layout the OS
+// has active. SendInput takes them with KEYEVENTF_SCANCODE and evdev KEY_* codes are
+// the same numbers outside the extended keys, which have the 0xE0 prefix byte set.
+static constexpr uint16_t SCAN_CODE_EXTENDED = 0xE000;
+
+// Scan code for a key name, A-Z, 0-9, -=[];',./\` or a word such as SPACE, LSHIFT,
+// UP or KP5 (case insensitive). 0 if there is no such key.
+uint16_t scan_code(const std::string &name);
+// Inverse of scan_code, "?" for codes without a name
+const char *key_name(uint16_t scan_code);
+
+// A keymap profile, which key each lane presses
+struct KeyboardLayout
+{
+    std::string m_name;
+    // Scan code per lane, left to right
+    std::vector<uint16_t> m_keys;
+    // The last m_air_lanes lanes are air sensors drawn above the others, 0 for plain keys
+    int m_air_lanes;
+
+    int lanes() const;
+    // Key names separated by spaces
+    std::string describe() const;
+};
+
+// Built in layouts followed by those loaded from keymap files, the first one is the default
+const std::vector<KeyboardLayout> &keyboard_layouts();
+
+// nullptr if there is no layout with that name
+const KeyboardLayout *find_keyboard_layout(const std::string &name);
+
+// Adds every profile in a keymap file, replacing layouts of the same name. Each line is
+//     <name> <air lanes> <key> <key> ...
+// with keys left to right, blank lines and lines starting with # are skipped.
+// Logs the first bad line and returns false without adding anything.
+bool load_keymap_file(const std::string &path);
@@ -0,0 +1,110 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+
+#include "spdlog/fmt/fmt.h"
+
+#include "Bits.hpp"
+
+LatencyHistogram::LatencyHistogram() : m_buckets(),
+                                       m_count(0),
+                                       m_sum(0),
+                                       m_max(0) {}
+
+int LatencyHistogram::bucket_index(int64_t nanos)
+{
+    uint64_t v = static_cast<uint64_t>(std::max<int64_t>(nanos, 0));
+    if (v < SUB_BUCKETS)
+    {
+        return static_cast<int>(v);
+    }
+
+    int msb = std::min(highest_bit(v), MAX_BITS);
+    int shift = msb - SUB_BUCKET_BITS;
+    int index = (shift + 1) * SUB_BUCKETS + static_cast<int>((v >> shift) & (SUB_BUCKETS - 1));
+    return std::min(index, N_BUCKETS - 1);
+}
+
+int64_t LatencyHistogram::bucket_upper_bound(int i)
+{
+    if (i < SUB_BUCKETS)
+    {
+        return i;
+    }
+
+    int shift = i / SUB_BUCKETS - 1;
+    int64_t sub = i % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(int64_t nanos)
+{
+    m_buckets[bucket_index(nanos)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(nanos, std::memory_order_relaxed);
+
+    int64_t prev_max = m_max.load(std::memory_order_relaxed);
+    while (prev_max < nanos && !m_max.compare_exchange_weak(prev_max, nanos, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &bucket : m_buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n ? m_sum.load(std::memory_order_relaxed) / static_cast<int64_t>(n) : 0;
+}
+
+int64_t LatencyHistogram::max() const
+{
+    return m_max.load(std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t n = count();
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * n + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < N_BUCKETS; i++)
+    {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+        {
+            return std::min(bucket_upper_bound(i), max());
+        }
+    }
+    return max();
+}
+
+std::string LatencyHistogram::summary() const
+{
+    return fmt::format("n={} mean={:.1f}us p50={:.1f}us p90={:.1f}us p99={:.1f}us p99.9={:.1f}us max={:.1f}us",
+                       count(),
+                       mean() / 1000.0,
+                       percentile(50) / 1000.0,
+                       percentile(90) / 1000.0,
+                       percentile(99) / 1000.0,
+                       percentile(99.9) / 1000.0,
+                       max() / 1000.0);
+}
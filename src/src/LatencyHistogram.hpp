@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Log-linear histogram of nanosecond durations, 8 sub-buckets per power of two
+// (~12% resolution). Recording is wait-free so it can be fed from any thread.
+struct LatencyHistogram
+{
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_BITS = 40; // ~18 minutes
+    static constexpr int N_BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    std::array<std::atomic_uint64_t, N_BUCKETS> m_buckets;
+    std::atomic_uint64_t m_count;
+    std::atomic_int64_t m_sum;
+    std::atomic_int64_t m_max;
+
+    LatencyHistogram();
+
+    void record(int64_t nanos);
+    void reset();
+
+    uint64_t count() const;
+    int64_t mean() const;
+    int64_t max() const;
+    int64_t percentile(double p) const;
+
+    std::string summary() const;
+
+    static int bucket_index(int64_t nanos);
+    static int64_t bucket_upper_bound(int i);
+};
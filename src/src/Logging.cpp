@@ -0,0 +1,41 @@
+#include "Logging.hpp"
+
+#include <cstdlib>
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+static void stop_async_logging()
+{
+    uint64_t dropped = dropped_log_messages();
+    if (dropped)
+    {
+        spdlog::warn("{} log messages dropped, the console could not keep up", dropped);
+    }
+
+    // Drains the queue and joins the logging thread
+    spdlog::shutdown();
+}
+
+void use_async_logging()
+{
+    spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+
+    // Unnamed like the default logger it replaces, so the output looks the same
+    auto logger = std::make_shared<spdlog::async_logger>("",
+                                                         std::make_shared<spdlog::sinks::stdout_color_sink_mt>(),
+                                                         spdlog::thread_pool(),
+                                                         spdlog::async_overflow_policy::overrun_oldest);
+    logger->set_level(spdlog::default_logger()->level());
+    spdlog::set_default_logger(logger);
+
+    // Before the registry's own destructor, and on the exit(1) error paths too
+    std::atexit(stop_async_logging);
+}
+
+uint64_t dropped_log_messages()
+{
+    auto pool = spdlog::thread_pool();
+    return pool ? pool->overrun_counter() : 0;
+}
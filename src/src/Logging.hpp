@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Messages waiting for the console, the oldest are dropped beyond this
+static constexpr size_t LOG_QUEUE_SIZE = 8192;
+
+// Replaces the default logger with one that formats and writes to the console on a
+// background thread. Logging from the network and injector threads then only queues
+// the message and never waits on a slow or paused console; when the queue is full
+// the oldest queued message is dropped instead. Queued messages are written out at exit.
+void use_async_logging();
+
+// Messages dropped because the queue was full
+uint64_t dropped_log_messages();
@@ -0,0 +1,81 @@
+#include "Metrics.hpp"
+
+#include "spdlog/fmt/fmt.h"
+
+#include "Clock.hpp"
+
+Metrics::Metrics() : m_frames(0),
+                     m_invalid_frames(0),
+                     m_duplicate_frames(0),
+                     m_reordered_frames(0),
+                     m_skipped_frames(0),
+                     m_loop_wakeups(0),
+                     m_forced_releases(0),
+                     m_edges_injected(0),
+                     m_edges_saved(0),
+                     m_schedule_delay(0),
+                     m_late_edges(0),
+                     m_start_time(now_nanos()),
+                     m_last_render_time(m_start_time),
+                     m_last_render_frames(0),
+                     m_last_render_edges(0) {}
+
+void Metrics::render_histogram(std::string &out, const char *name, const char *help, const LatencyHistogram &histogram)
+{
+    out += fmt::format("# HELP {} {}\n# TYPE {} summary\n", name, help, name);
+    for (double quantile : {0.5, 0.9, 0.99, 0.999})
+    {
+        out += fmt::format("{}{{quantile=\"{}\"}} {:.9f}\n", name, quantile, histogram.percentile(quantile * 100) / 1e9);
+    }
+    out += fmt::format("{}_sum {:.9f}\n", name, histogram.m_sum.load(std::memory_order_relaxed) / 1e9);
+    out += fmt::format("{}_count {}\n", name, histogram.count());
+    out += fmt::format("# TYPE {}_max gauge\n{}_max {:.9f}\n", name, name, histogram.max() / 1e9);
+}
+
+void Metrics::render_value(std::string &out, const char *name, const char *type, const char *help, double value)
+{
+    out += fmt::format("# HELP {} {}\n# TYPE {} {}\n{} {}\n", name, help, name, type, name, value);
+}
+
+void Metrics::render(std::string &out)
+{
+    int64_t now = now_nanos();
+    uint64_t frames = m_frames.load(std::memory_order_relaxed);
+    uint64_t edges = m_edges_injected.load(std::memory_order_relaxed);
+
+    double window = (now - m_last_render_time) / 1e9;
+    double frame_rate = window > 0 ? (frames - m_last_render_frames) / window : 0;
+    double edge_rate = window > 0 ? (edges - m_last_render_edges) / window : 0;
+
+    m_last_render_time = now;
+    m_last_render_frames = frames;
+    m_last_render_edges = edges;
+
+    render_value(out, "droidmaniac_uptime_seconds", "gauge", "Seconds since the server started", (now - m_start_time) / 1e9);
+
+    render_histogram(out, "droidmaniac_touch_to_receive_seconds", "Controller touch to socket read, estimated from the synced controller clock", m_touch_to_receive);
+    render_histogram(out, "droidmaniac_receive_to_publish_seconds", "Socket read to key edges published", m_receive_to_publish);
+    render_histogram(out, "droidmaniac_publish_to_inject_seconds", "Key edges published to injected", m_publish_to_inject);
+    render_histogram(out, "droidmaniac_receive_to_inject_seconds", "Socket read to key injected", m_receive_to_inject);
+    render_histogram(out, "droidmaniac_touch_to_inject_seconds", "Controller touch to key injected, estimated from the synced controller clock", m_touch_to_inject);
+
+    render_value(out, "droidmaniac_frames_total", "counter", "Input frames accepted", static_cast<double>(frames));
+    render_value(out, "droidmaniac_frames_per_second", "gauge", "Input frames accepted per second since the last scrape", frame_rate);
+
+    out += "# HELP droidmaniac_frames_dropped_total Input frames dropped\n# TYPE droidmaniac_frames_dropped_total counter\n";
+    out += fmt::format("droidmaniac_frames_dropped_total{{reason=\"invalid\"}} {}\n", m_invalid_frames.load(std::memory_order_relaxed));
+    out += fmt::format("droidmaniac_frames_dropped_total{{reason=\"duplicate\"}} {}\n", m_duplicate_frames.load(std::memory_order_relaxed));
+    out += fmt::format("droidmaniac_frames_dropped_total{{reason=\"reordered\"}} {}\n", m_reordered_frames.load(std::memory_order_relaxed));
+    render_value(out, "droidmaniac_frames_skipped_total", "counter", "Gaps in frame sequence numbers", static_cast<double>(m_skipped_frames.load(std::memory_order_relaxed)));
+    render_value(out, "droidmaniac_loop_wakeups_total", "counter", "Server event loop iterations", static_cast<double>(m_loop_wakeups.load(std::memory_order_relaxed)));
+    render_histogram(out, "droidmaniac_heartbeat_detection_seconds", "Last message from a controller to noticing it missed the heartbeat deadline", m_heartbeat_detection);
+    render_value(out, "droidmaniac_forced_releases_total", "counter", "Controllers whose held lanes were released for missing the heartbeat deadline", static_cast<double>(m_forced_releases.load(std::memory_order_relaxed)));
+
+    render_value(out, "droidmaniac_edges_injected_total", "counter", "Key edges injected", static_cast<double>(edges));
+    render_value(out, "droidmaniac_edges_per_second", "gauge", "Key edges injected per second since the last scrape", edge_rate);
+    render_histogram(out, "droidmaniac_timer_overshoot_seconds", "Injector timer wakeup past its deadline", m_timer_overshoot);
+    render_value(out, "droidmaniac_schedule_delay_seconds", "gauge", "Target touch to inject delay of scheduled dispatch", m_schedule_delay.load(std::memory_order_relaxed) / 1e9);
+    render_histogram(out, "droidmaniac_schedule_lateness_seconds", "Scheduled dispatch, injection time past the due time", m_schedule_lateness);
+    render_value(out, "droidmaniac_late_edges_total", "counter", "Scheduled dispatch, edges that arrived after their due time", static_cast<double>(m_late_edges.load(std::memory_order_relaxed)));
+    render_value(out, "droidmaniac_edges_saved_total", "counter", "Key edges that sampling the state at the polling frequency would have lost", static_cast<double>(m_edges_saved.load(std::memory_order_relaxed)));
+}
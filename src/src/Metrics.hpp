@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "LatencyHistogram.hpp"
+
+// Counters and latency histograms for the input path, written lock-free from the
+// server and injector threads and rendered in Prometheus text format for /metrics
+struct Metrics
+{
+    // Controller sampled the touch -> socket read, needs a synced controller clock
+    LatencyHistogram m_touch_to_receive;
+    // Socket read in the message handler -> edges published by ControllerState
+    LatencyHistogram m_receive_to_publish;
+    // Edges published -> injected by the keyboard backend
+    LatencyHistogram m_publish_to_inject;
+    // Socket read -> injected, what the player feels
+    LatencyHistogram m_receive_to_inject;
+    // Controller sampled the touch -> injected, needs a synced controller clock
+    LatencyHistogram m_touch_to_inject;
+    // Scheduled dispatch only, how far past its due time each edge was injected
+    LatencyHistogram m_schedule_lateness;
+    // Poll and scheduled dispatch, how late the injector's precision timer woke up
+    LatencyHistogram m_timer_overshoot;
+    // Last message from a controller -> noticed it missed the heartbeat deadline
+    LatencyHistogram m_heartbeat_detection;
+
+    std::atomic_uint64_t m_frames;
+    std::atomic_uint64_t m_invalid_frames;
+    std::atomic_uint64_t m_duplicate_frames;
+    std::atomic_uint64_t m_reordered_frames;
+    std::atomic_uint64_t m_skipped_frames;
+
+    // Times the server's event loop woke up, one epoll_wait/kevent/uv_run pass each
+    std::atomic_uint64_t m_loop_wakeups;
+
+    // Controllers that missed the heartbeat deadline while holding lanes, which were released
+    std::atomic_uint64_t m_forced_releases;
+
+    std::atomic_uint64_t m_edges_injected;
+    // Edges that sampling the state once per polling period would have lost, counted from
+    // the edges' receive times in every dispatch mode
+    std::atomic_uint64_t m_edges_saved;
+
+    // Scheduled dispatch target delay, and edges that reached the injector after their due time
+    std::atomic_int64_t m_schedule_delay;
+    std::atomic_uint64_t m_late_edges;
+
+    int64_t m_start_time;
+
+    // Rate window, only touched by the thread rendering the metrics
+    int64_t m_last_render_time;
+    uint64_t m_last_render_frames;
+    uint64_t m_last_render_edges;
+
+    Metrics();
+
+    void render(std::string &out);
+
+    static void render_histogram(std::string &out, const char *name, const char *help, const LatencyHistogram &histogram);
+    static void render_value(std::string &out, const char *name, const char *type, const char *help, double value);
+};
@@ -0,0 +1,123 @@
+#include "PrecisionTimer.hpp"
+
+#include <thread>
+
+#include "Clock.hpp"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <timeapi.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+struct PrecisionTimer::Impl
+{
+    HANDLE m_timer;
+    bool m_high_resolution;
+    int64_t m_spin_nanos;
+
+    Impl()
+    {
+        // High resolution timers need Windows 10 1803, fall back to a 1 ms system timer period
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        m_high_resolution = m_timer != nullptr;
+        if (!m_high_resolution)
+        {
+            m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+            timeBeginPeriod(1);
+        }
+        m_spin_nanos = m_high_resolution ? 500000 : 2000000;
+    }
+
+    ~Impl()
+    {
+        if (!m_high_resolution)
+        {
+            timeEndPeriod(1);
+        }
+        if (m_timer)
+        {
+            CloseHandle(m_timer);
+        }
+    }
+
+    void os_sleep_until(int64_t deadline)
+    {
+        int64_t remaining = deadline - now_nanos();
+        if (remaining <= 0 || !m_timer)
+        {
+            return;
+        }
+
+        // Negative due times are relative, in 100 ns units
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -(remaining / 100);
+        if (SetWaitableTimerEx(m_timer, &due_time, 0, nullptr, nullptr, nullptr, 0))
+        {
+            WaitForSingleObject(m_timer, INFINITE);
+        }
+    }
+
+    const char *method() const
+    {
+        return m_high_resolution ? "high resolution waitable timer" : "waitable timer";
+    }
+};
+
+#else
+
+#include <cerrno>
+#include <time.h>
+
+struct PrecisionTimer::Impl
+{
+    int64_t m_spin_nanos;
+
+    Impl() : m_spin_nanos(50000) {}
+
+    void os_sleep_until(int64_t deadline)
+    {
+        // steady_clock is CLOCK_MONOTONIC, so now_nanos() deadlines can be handed over as is
+        timespec ts;
+        ts.tv_sec = deadline / 1000000000;
+        ts.tv_nsec = deadline % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        {
+        }
+    }
+
+    const char *method() const
+    {
+        return "clock_nanosleep";
+    }
+};
+
+#endif
+
+PrecisionTimer::PrecisionTimer() : m_impl(std::make_unique<Impl>()) {}
+
+PrecisionTimer::~PrecisionTimer() = default;
+
+int64_t PrecisionTimer::sleep_until(int64_t deadline)
+{
+    if (deadline - now_nanos() > m_impl->m_spin_nanos)
+    {
+        m_impl->os_sleep_until(deadline - m_impl->m_spin_nanos);
+    }
+
+    int64_t now = now_nanos();
+    while (now < deadline)
+    {
+        std::this_thread::yield();
+        now = now_nanos();
+    }
+    return now - deadline;
+}
+
+const char *PrecisionTimer::method() const
+{
+    return m_impl->method();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+// Sleeps until absolute deadlines on the now_nanos() clock. The OS sleeps for most
+// of the wait (clock_nanosleep with TIMER_ABSTIME on Linux, a high resolution
+// waitable timer on Windows) and the last stretch is spun, so wakeups land within
+// microseconds of the deadline and periodic loops do not drift.
+struct PrecisionTimer
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    PrecisionTimer();
+    ~PrecisionTimer();
+
+    // Returns how late the wakeup was in nanoseconds
+    int64_t sleep_until(int64_t deadline);
+
+    // Name of the OS sleep used, for diagnostics
+    const char *method() const;
+};
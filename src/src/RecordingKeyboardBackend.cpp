@@ -0,0 +1,79 @@
+#include "RecordingKeyboardBackend.hpp"
+
+#include <algorithm>
+
+#include "spdlog/spdlog.h"
+
+#include "Clock.hpp"
+
+RecordingKeyboardBackend::RecordingKeyboardBackend(int lanes, size_t max_events)
+    : m_lanes(lanes),
+      m_max_events(max_events),
+      m_batches(0),
+      m_dropped_events(0)
+{
+    m_pending.reserve(64);
+}
+
+int RecordingKeyboardBackend::lanes() const
+{
+    return m_lanes;
+}
+
+// Logs like the real backends so benchmarks see the cost of verbose output
+void RecordingKeyboardBackend::key_down(int i)
+{
+    SPDLOG_DEBUG("Lane {} Down", i);
+    m_pending.push_back({0, 0, i, true});
+}
+
+void RecordingKeyboardBackend::key_up(int i)
+{
+    SPDLOG_DEBUG("Lane {} Up", i);
+    m_pending.push_back({0, 0, i, false});
+}
+
+void RecordingKeyboardBackend::flush()
+{
+    if (m_pending.empty())
+    {
+        return;
+    }
+
+    int64_t now = now_nanos();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_events.size() + m_pending.size() > m_max_events)
+    {
+        // Dropping half at a time keeps the cost per event constant
+        size_t drop = std::min(m_events.size(), std::max(m_events.size() / 2, m_pending.size()));
+        if (m_dropped_events == 0)
+        {
+            spdlog::warn("Recording backend holds {} key events nobody collected, discarding the oldest", m_events.size());
+        }
+        m_events.erase(m_events.begin(), m_events.begin() + drop);
+        m_dropped_events += drop;
+    }
+    for (auto &event : m_pending)
+    {
+        event.m_time = now;
+        event.m_batch = m_batches;
+        m_events.push_back(event);
+    }
+    m_batches++;
+    m_pending.clear();
+}
+
+std::vector<RecordedKeyEvent> RecordingKeyboardBackend::take_events()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<RecordedKeyEvent> events;
+    events.swap(m_events);
+    return events;
+}
+
+uint64_t RecordingKeyboardBackend::dropped_events()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_dropped_events;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "KeyboardBackend.hpp"
+
+struct RecordedKeyEvent
+{
+    int64_t m_time;   // When the batch holding this event was flushed
+    uint64_t m_batch; // Events flushed together share a batch number
+    int m_lane;
+    bool m_pressed;
+};
+
+// Default cap on events kept between take_events() calls, 24 MiB
+static constexpr size_t MAX_RECORDED_EVENTS = 1 << 20;
+
+// Keeps injected events in memory instead of sending them anywhere,
+// so the whole input pipeline can run headless. Once max_events are waiting
+// the oldest half is discarded, so a server left running with -b record stays bounded.
+struct RecordingKeyboardBackend : KeyboardBackend
+{
+    int m_lanes;
+
+    std::vector<RecordedKeyEvent> m_pending;
+
+    std::mutex m_mutex;
+    std::vector<RecordedKeyEvent> m_events;
+    size_t m_max_events;
+    uint64_t m_batches;
+    uint64_t m_dropped_events;
+
+    RecordingKeyboardBackend(int lanes = 64, size_t max_events = MAX_RECORDED_EVENTS);
+
+    int lanes() const override;
+
+    void key_down(int i) override;
+    void key_up(int i) override;
+    void flush() override;
+
+    // Moves out everything flushed so far, safe to call from another thread
+    std::vector<RecordedKeyEvent> take_events();
+    uint64_t dropped_events();
+};
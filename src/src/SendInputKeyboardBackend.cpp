@@ -0,0 +1,114 @@
+#ifdef _WIN32
+
+#include "KeyboardBackend.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <Windows.h>
+
+// https://learn.microsoft.com/en-us/windows/win32/api/winuser/ns-winuser-keybdinput
+
+// Edges for the same key may repeat within one batch, so size for more than one per button
+static constexpr int INPUT_BUFFER_SIZE = 64;
+
+using SendInputHandleType = UINT(WINAPI *)(UINT, LPINPUT, int);
+static SendInputHandleType SendInputHandle = reinterpret_cast<SendInputHandleType>(GetProcAddress(GetModuleHandleW((L"user32")), "SendInput"));
+
+struct SendInputKeyboardBackend : KeyboardBackend
+{
+    // Scan code and KEYEVENTF_ flags per lane, sent without a virtual key so the
+    // game sees the physical key whatever layout Windows has active
+    WORD m_layout[64];
+    DWORD m_flags[64];
+    int m_lanes;
+    INPUT m_input_buffer[INPUT_BUFFER_SIZE];
+    int m_buffered_keys;
+
+    SendInputKeyboardBackend();
+
+    void set_layout(const KeyboardLayout &layout);
+
+    int lanes() const override;
+
+    void key_down(int i) override;
+    void key_up(int i) override;
+    void flush() override;
+
+private:
+    void push_key(int i, DWORD flags);
+};
+
+SendInputKeyboardBackend::SendInputKeyboardBackend()
+    : m_layout(),
+      m_flags(),
+      m_lanes(0),
+      m_buffered_keys(0)
+{
+    // Zero out buffer
+    for (int i = 0; i < INPUT_BUFFER_SIZE; i++)
+    {
+        m_input_buffer[i].type = INPUT_KEYBOARD;
+        m_input_buffer[i].ki.wVk = 0;
+        m_input_buffer[i].ki.wScan = 0;
+        m_input_buffer[i].ki.dwFlags = 0;
+        m_input_buffer[i].ki.time = 0;
+        m_input_buffer[i].ki.dwExtraInfo = 0;
+    }
+}
+
+void SendInputKeyboardBackend::set_layout(const KeyboardLayout &layout)
+{
+    m_lanes = layout.lanes();
+    for (int i = 0; i < m_lanes; i++)
+    {
+        m_layout[i] = layout.m_keys[i] & 0xFF;
+        m_flags[i] = KEYEVENTF_SCANCODE | (layout.m_keys[i] & SCAN_CODE_EXTENDED ? KEYEVENTF_EXTENDEDKEY : 0);
+    }
+}
+
+int SendInputKeyboardBackend::lanes() const
+{
+    return m_lanes;
+}
+
+void SendInputKeyboardBackend::push_key(int i, DWORD flags)
+{
+    if (m_buffered_keys == INPUT_BUFFER_SIZE)
+    {
+        flush();
+    }
+
+    m_input_buffer[m_buffered_keys].ki.wScan = m_layout[i];
+    m_input_buffer[m_buffered_keys].ki.dwFlags = m_flags[i] | flags;
+    m_buffered_keys++;
+}
+
+void SendInputKeyboardBackend::key_down(int i)
+{
+    SPDLOG_DEBUG("{:#x} Down", m_layout[i]);
+    push_key(i, 0);
+}
+
+void SendInputKeyboardBackend::key_up(int i)
+{
+    SPDLOG_DEBUG("{:#x} Up", m_layout[i]);
+    push_key(i, KEYEVENTF_KEYUP);
+}
+
+void SendInputKeyboardBackend::flush()
+{
+    if (m_buffered_keys)
+    {
+        SendInputHandle(m_buffered_keys, m_input_buffer, sizeof(INPUT));
+    }
+    m_buffered_keys = 0;
+}
+
+std::unique_ptr<KeyboardBackend> create_sendinput_backend(const KeyboardLayout &layout)
+{
+    auto backend = std::make_unique<SendInputKeyboardBackend>();
+    backend->set_layout(layout);
+    return backend;
+}
+
+#endif
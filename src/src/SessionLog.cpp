@@ -0,0 +1,464 @@
+#include "SessionLog.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+#include "Clock.hpp"
+#include "InputProtocol.hpp"
+#include "PrecisionTimer.hpp"
+
+// A second of a busy 8 controller session is well under 100 KiB
+static constexpr size_t RING_SIZE = 1 << 20;
+// The file grows and is mapped this much at a time, a multiple of every allocation granularity
+static constexpr size_t CHUNK_SIZE = 4 << 20;
+// How often the writer thread drains the ring
+static const int WRITE_INTERVAL_MILLIS = 10;
+// Longest a paced replay sleeps before looking at its running flag again
+static constexpr int64_t REPLAY_STOP_CHECK_NANOS = 100000000;
+
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+
+// Write-only file mapped one chunk at a time
+struct MappedFile
+{
+    HANDLE m_file;
+    uint8_t *m_view;
+
+    MappedFile() : m_file(INVALID_HANDLE_VALUE), m_view(nullptr) {}
+
+    bool open(const std::string &path)
+    {
+        m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return m_file != INVALID_HANDLE_VALUE;
+    }
+
+    // Grows the file to hold chunk and maps it in place of the previous one
+    uint8_t *map_chunk(uint64_t chunk)
+    {
+        unmap();
+
+        uint64_t end = (chunk + 1) * CHUNK_SIZE;
+        uint64_t offset = chunk * CHUNK_SIZE;
+        HANDLE mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(end >> 32), static_cast<DWORD>(end), nullptr);
+        if (!mapping)
+        {
+            return nullptr;
+        }
+        // The view keeps the mapping alive
+        m_view = static_cast<uint8_t *>(MapViewOfFile(mapping, FILE_MAP_WRITE, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), CHUNK_SIZE));
+        CloseHandle(mapping);
+        return m_view;
+    }
+
+    void unmap()
+    {
+        if (m_view)
+        {
+            UnmapViewOfFile(m_view);
+            m_view = nullptr;
+        }
+    }
+
+    void close(uint64_t size)
+    {
+        unmap();
+        if (m_file != INVALID_HANDLE_VALUE)
+        {
+            LARGE_INTEGER end;
+            end.QuadPart = static_cast<LONGLONG>(size);
+            SetFilePointerEx(m_file, end, nullptr, FILE_BEGIN);
+            SetEndOfFile(m_file);
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+    }
+};
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Write-only file mapped one chunk at a time
+struct MappedFile
+{
+    int m_file;
+    uint8_t *m_view;
+
+    MappedFile() : m_file(-1), m_view(nullptr) {}
+
+    bool open(const std::string &path)
+    {
+        m_file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        return m_file >= 0;
+    }
+
+    // Grows the file to hold chunk and maps it in place of the previous one
+    uint8_t *map_chunk(uint64_t chunk)
+    {
+        unmap();
+
+        if (ftruncate(m_file, static_cast<off_t>((chunk + 1) * CHUNK_SIZE)) != 0)
+        {
+            return nullptr;
+        }
+        void *view = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, static_cast<off_t>(chunk * CHUNK_SIZE));
+        m_view = view == MAP_FAILED ? nullptr : static_cast<uint8_t *>(view);
+        return m_view;
+    }
+
+    void unmap()
+    {
+        if (m_view)
+        {
+            munmap(m_view, CHUNK_SIZE);
+            m_view = nullptr;
+        }
+    }
+
+    void close(uint64_t size)
+    {
+        unmap();
+        if (m_file >= 0)
+        {
+            if (ftruncate(m_file, static_cast<off_t>(size)) != 0)
+            {
+                spdlog::warn("Cannot trim session log, it ends in zeroes");
+            }
+            ::close(m_file);
+            m_file = -1;
+        }
+    }
+};
+
+#endif
+
+struct SessionRecorder::Impl
+{
+    std::unique_ptr<uint8_t[]> m_ring;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic_size_t m_head;
+    alignas(64) std::atomic_size_t m_tail;
+
+    std::atomic_uint64_t m_records;
+    std::atomic_uint64_t m_dropped_records;
+    std::atomic_uint64_t m_bytes_written;
+
+    MappedFile m_file;
+    uint64_t m_chunk;
+    uint8_t *m_view;
+    size_t m_view_offset;
+    bool m_failed;
+
+    std::atomic_bool m_running;
+    std::thread m_thread;
+
+    Impl() : m_ring(std::make_unique<uint8_t[]>(RING_SIZE)),
+             m_head(0),
+             m_tail(0),
+             m_records(0),
+             m_dropped_records(0),
+             m_bytes_written(0),
+             m_chunk(0),
+             m_view(nullptr),
+             m_view_offset(0),
+             m_failed(false),
+             m_running(false)
+    {
+    }
+
+    void push(size_t position, const void *data, size_t size)
+    {
+        size_t start = position & (RING_SIZE - 1);
+        size_t first = std::min(size, RING_SIZE - start);
+        std::memcpy(m_ring.get() + start, data, first);
+        std::memcpy(m_ring.get(), static_cast<const uint8_t *>(data) + first, size - first);
+    }
+
+    void append(const uint8_t *data, size_t size)
+    {
+        while (size && !m_failed)
+        {
+            if (!m_view || m_view_offset == CHUNK_SIZE)
+            {
+                m_view = m_file.map_chunk(m_view ? ++m_chunk : m_chunk);
+                m_view_offset = 0;
+                if (!m_view)
+                {
+                    spdlog::error("Cannot extend session log, recording stopped");
+                    m_failed = true;
+                    return;
+                }
+            }
+
+            size_t n = std::min(size, CHUNK_SIZE - m_view_offset);
+            std::memcpy(m_view + m_view_offset, data, n);
+            m_view_offset += n;
+            m_bytes_written.fetch_add(n, std::memory_order_relaxed);
+            data += n;
+            size -= n;
+        }
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            // Checked before the ring so nothing recorded before close() is left behind
+            bool stopping = !m_running.load();
+
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t tail = m_tail.load(std::memory_order_acquire);
+            if (head != tail)
+            {
+                size_t start = head & (RING_SIZE - 1);
+                size_t first = std::min(tail - head, RING_SIZE - start);
+                append(m_ring.get() + start, first);
+                append(m_ring.get(), tail - head - first);
+                m_head.store(tail, std::memory_order_release);
+            }
+            else if (stopping)
+            {
+                break;
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(WRITE_INTERVAL_MILLIS));
+            }
+        }
+    }
+};
+
+SessionRecorder::SessionRecorder() : m_impl(std::make_unique<Impl>()) {}
+
+SessionRecorder::~SessionRecorder()
+{
+    close();
+}
+
+bool SessionRecorder::open(const std::string &path)
+{
+    if (!m_impl->m_file.open(path))
+    {
+        spdlog::error("Cannot create session log {}", path);
+        return false;
+    }
+
+    m_impl->append(reinterpret_cast<const uint8_t *>(SESSION_LOG_MAGIC), sizeof(SESSION_LOG_MAGIC));
+    m_impl->m_running = true;
+    m_impl->m_thread = std::thread([this] { m_impl->run(); });
+    return !m_impl->m_failed;
+}
+
+void SessionRecorder::close()
+{
+    m_impl->m_running = false;
+    if (m_impl->m_thread.joinable())
+    {
+        m_impl->m_thread.join();
+    }
+    m_impl->m_file.close(m_impl->m_bytes_written.load());
+    m_impl->m_view = nullptr;
+}
+
+void SessionRecorder::record(SessionRecordHeader::RecordType type, int slot, uint32_t connection, int64_t receive_time, int64_t touch_time, std::string_view payload)
+{
+    Impl &impl = *m_impl;
+
+    size_t size = std::min(payload.size(), MAX_RECORD_PAYLOAD);
+    SessionRecordHeader header = {type, static_cast<int8_t>(slot), static_cast<uint16_t>(size), connection, receive_time, touch_time};
+
+    size_t tail = impl.m_tail.load(std::memory_order_relaxed);
+    if (RING_SIZE - (tail - impl.m_head.load(std::memory_order_acquire)) < sizeof(header) + size)
+    {
+        impl.m_dropped_records.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    impl.push(tail, &header, sizeof(header));
+    impl.push(tail + sizeof(header), payload.data(), size);
+    impl.m_tail.store(tail + sizeof(header) + size, std::memory_order_release);
+    impl.m_records.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t SessionRecorder::records() const
+{
+    return m_impl->m_records.load();
+}
+
+uint64_t SessionRecorder::dropped_records() const
+{
+    return m_impl->m_dropped_records.load();
+}
+
+uint64_t SessionRecorder::bytes_written() const
+{
+    return m_impl->m_bytes_written.load();
+}
+
+SessionReader::SessionReader() : m_file(nullptr) {}
+
+SessionReader::~SessionReader()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+    }
+}
+
+bool SessionReader::open(const std::string &path)
+{
+    m_file = std::fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        spdlog::error("Cannot open session log {}", path);
+        return false;
+    }
+
+    char magic[sizeof(SESSION_LOG_MAGIC)];
+    if (std::fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) || std::memcmp(magic, SESSION_LOG_MAGIC, sizeof(magic)) != 0)
+    {
+        spdlog::error("{} is not a session log", path);
+        return false;
+    }
+    return true;
+}
+
+bool SessionReader::next(SessionRecordHeader &header, std::string_view &payload)
+{
+    if (std::fread(&header, sizeof(header), 1, m_file) != 1 || header.m_type == SessionRecordHeader::RECORD_END)
+    {
+        return false;
+    }
+    if (header.m_size > MAX_RECORD_PAYLOAD || std::fread(m_payload, 1, header.m_size, m_file) != header.m_size)
+    {
+        spdlog::warn("Session log is truncated or corrupt, stopping at the last whole record");
+        return false;
+    }
+
+    payload = std::string_view(reinterpret_cast<const char *>(m_payload), header.m_size);
+    return true;
+}
+
+bool replay_session(const std::string &path, ControllerState &controller_state, Metrics &metrics, double speed, const std::atomic_bool &running, ReplayStats &stats)
+{
+    SessionReader reader;
+    if (!reader.open(path))
+    {
+        return false;
+    }
+
+    // Recorded slot -> slot taken in controller_state, which need not be the same
+    std::array<int, MAX_CONTROLLERS> slots;
+    slots.fill(-1);
+
+    PrecisionTimer timer;
+    int64_t start_time = 0;
+    int64_t first_receive_time = 0;
+
+    SessionRecordHeader header;
+    std::string_view payload;
+    while (running && reader.next(header, payload))
+    {
+        if (stats.m_records++ == 0)
+        {
+            start_time = now_nanos();
+            first_receive_time = header.m_receive_time;
+        }
+        stats.m_recorded_nanos = header.m_receive_time - first_receive_time;
+        if (speed > 0)
+        {
+            // Recorded gaps can be minutes long, sleep them in steps so a stop is not held up
+            int64_t deadline = start_time + static_cast<int64_t>(stats.m_recorded_nanos / speed);
+            while (running && deadline - now_nanos() > REPLAY_STOP_CHECK_NANOS)
+            {
+                timer.sleep_until(now_nanos() + REPLAY_STOP_CHECK_NANOS);
+            }
+            if (!running)
+            {
+                break;
+            }
+            timer.sleep_until(deadline);
+        }
+
+        if (header.m_slot < 0 || MAX_CONTROLLERS <= header.m_slot)
+        {
+            continue;
+        }
+        int &slot = slots[header.m_slot];
+
+        switch (header.m_type)
+        {
+        case SessionRecordHeader::RECORD_OPEN:
+            slot = controller_state.acquire_slot();
+            break;
+        case SessionRecordHeader::RECORD_CLOSE:
+            if (slot >= 0)
+            {
+                controller_state.release_slot(slot);
+                slot = -1;
+            }
+            break;
+        case SessionRecordHeader::RECORD_BINARY_FRAME:
+        case SessionRecordHeader::RECORD_TEXT_FRAME:
+        {
+            InputFrame frame;
+            bool parsed = header.m_type == SessionRecordHeader::RECORD_BINARY_FRAME ? parse_binary_frame(payload, frame) : parse_text_frame(payload, frame);
+            if (!parsed)
+            {
+                stats.m_mismatched_frames++;
+                break;
+            }
+            if (slot < 0)
+            {
+                break;
+            }
+
+            // Nothing paces a full speed replay, wait for the injector rather than overflow its queue
+            while (speed == 0 && running && controller_state.m_edges.size() > EDGE_QUEUE_SIZE - MAX_CONTROLLERS)
+            {
+                std::this_thread::yield();
+            }
+
+            // Keep the recorded network delay, scaling it would skew scheduled dispatch
+            int64_t receive_time = now_nanos();
+            int64_t touch_time = header.m_touch_time ? receive_time - (header.m_receive_time - header.m_touch_time) : 0;
+            controller_state.update(slot, frame.m_buttons, receive_time, touch_time);
+            metrics.m_frames.fetch_add(1, std::memory_order_relaxed);
+            metrics.m_receive_to_publish.record(now_nanos() - receive_time);
+            stats.m_frames++;
+            break;
+        }
+        case SessionRecordHeader::RECORD_TIMEOUT:
+            if (slot >= 0)
+            {
+                controller_state.update(slot, 0, now_nanos(), 0);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    for (int &slot : slots)
+    {
+        if (slot >= 0)
+        {
+            controller_state.release_slot(slot);
+            slot = -1;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ControllerState.hpp"
+#include "Metrics.hpp"
+
+// Session log, an append-only record of every input message controllers sent so a
+// reported dropped note can be played back through the input pipeline later.
+//
+// The file starts with SESSION_LOG_MAGIC followed by records, each a
+// SessionRecordHeader and m_size payload bytes, in host byte order (every
+// supported platform is little-endian). A zeroed header marks the end of a log
+// that was not closed cleanly.
+static constexpr char SESSION_LOG_MAGIC[8] = {'D', 'M', 'S', 'E', 'S', 'S', '0', '1'};
+
+struct SessionRecordHeader
+{
+    enum RecordType : uint8_t
+    {
+        RECORD_END,          // Zeroed tail of an unfinished log
+        RECORD_OPEN,         // Controller connected in m_slot, -1 if every slot was taken
+        RECORD_CLOSE,        // Controller in m_slot disconnected
+        RECORD_BINARY_FRAME, // Binary message, payload as received
+        RECORD_TEXT_FRAME,   // Legacy text input frame, payload as received
+        RECORD_TIMEOUT,      // Controller in m_slot missed the heartbeat deadline, its lanes were released
+    };
+
+    uint8_t m_type;
+    int8_t m_slot;        // For frames the slot they were applied to, -1 if the server rejected them
+    uint16_t m_size;      // Payload bytes after the header
+    uint32_t m_connection;
+    int64_t m_receive_time;
+    int64_t m_touch_time; // 0 if the controller's clock was not synced
+};
+
+static_assert(sizeof(SessionRecordHeader) == 24, "SessionRecordHeader is written to disk as is");
+
+// Longer messages are cut short, no valid input frame comes close
+static constexpr size_t MAX_RECORD_PAYLOAD = 1024;
+
+// Records go into a lock-free ring on the server thread and a background thread
+// copies them into the log file, mapped into memory a few MiB at a time. Recording
+// never blocks, allocates or makes a syscall, if the writer falls behind records
+// are dropped and counted.
+struct SessionRecorder
+{
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+    SessionRecorder();
+    ~SessionRecorder();
+
+    // Creates or truncates the file and starts the writer thread
+    bool open(const std::string &path);
+    // Writes out everything recorded so far and trims the file to its contents
+    void close();
+
+    // One producer thread only
+    void record(SessionRecordHeader::RecordType type, int slot, uint32_t connection, int64_t receive_time, int64_t touch_time, std::string_view payload);
+
+    uint64_t records() const;
+    uint64_t dropped_records() const;
+    uint64_t bytes_written() const;
+};
+
+struct SessionReader
+{
+    std::FILE *m_file;
+    uint8_t m_payload[MAX_RECORD_PAYLOAD];
+
+    SessionReader();
+    ~SessionReader();
+
+    bool open(const std::string &path);
+    // False at the end of the log, payload stays valid until the next call
+    bool next(SessionRecordHeader &header, std::string_view &payload);
+};
+
+struct ReplayStats
+{
+    uint64_t m_records;
+    uint64_t m_frames;
+    // Frames the server applied that no longer parse
+    uint64_t m_mismatched_frames;
+    int64_t m_recorded_nanos;
+
+    ReplayStats() : m_records(0), m_frames(0), m_mismatched_frames(0), m_recorded_nanos(0) {}
+};
+
+// Feeds a session log through controller_state on the calling thread, which takes the
+// place of the server thread. Frames the server rejected stay rejected, the others are
+// parsed again and published with their recorded spacing scaled by 1 / speed (0 replays
+// as fast as possible) and their recorded touch to receive delay. Stops early when
+// running turns false and releases every slot it connected before returning.
+bool replay_session(const std::string &path, ControllerState &controller_state, Metrics &metrics, double speed, const std::atomic_bool &running, ReplayStats &stats);
@@ -0,0 +1,566 @@
+#include "StaticAssets.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <vector>
+
+#ifdef DROIDMANIAC_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DROIDMANIAC_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "fmt/format.h"
+#include "spdlog/spdlog.h"
+
+#include "EmbeddedAssets.hpp"
+
+static const char *const ENCODING_NAMES[] = {"identity", "gzip", "br"};
+static const char *const ETAG_SUFFIXES[] = {"", "-gz", "-br"};
+
+struct FileType
+{
+    const char *m_extension;
+    const char *m_content_type;
+    const char *m_cache_control;
+};
+
+// Pages and scripts are revalidated on every load so edits show up at once,
+// a 304 makes that cheap. Images rarely change and can be kept for a day.
+static const char *const HTML_CONTENT_TYPE = "text/html; charset=utf-8";
+static const FileType FILE_TYPES[] = {
+    {".html", HTML_CONTENT_TYPE, "no-cache"},
+    {".js", "application/javascript; charset=utf-8", "no-cache"},
+    {".css", "text/css; charset=utf-8", "no-cache"},
+    {".json", "application/json", "no-cache"},
+    {".txt", "text/plain; charset=utf-8", "no-cache"},
+    {".svg", "image/svg+xml", "max-age=86400"},
+    {".png", "image/png", "max-age=86400"},
+    {".jpg", "image/jpeg", "max-age=86400"},
+    {".ico", "image/x-icon", "max-age=86400"},
+    {".woff2", "font/woff2", "max-age=86400"},
+};
+static const FileType DEFAULT_FILE_TYPE = {"", "application/octet-stream", "no-cache"};
+static const char *const IMMUTABLE_CACHE_CONTROL = "public, max-age=31536000, immutable";
+static const char *const SERVICE_WORKER_URL = "/sw.js";
+
+static const FileType &file_type(const std::filesystem::path &path)
+{
+    std::string extension = path.extension().string();
+    for (const FileType &type : FILE_TYPES)
+    {
+        if (extension == type.m_extension)
+        {
+            return type;
+        }
+    }
+    return DEFAULT_FILE_TYPE;
+}
+
+static uint64_t fnv1a(std::string_view data)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c : data)
+    {
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool compress(StaticAsset::Encoding encoding, const std::string &in, std::string &out)
+{
+    switch (encoding)
+    {
+#ifdef DROIDMANIAC_WITH_ZLIB
+    case StaticAsset::ENCODING_GZIP:
+    {
+        z_stream stream = {};
+        // 16 + window bits asks for a gzip wrapper
+        if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            return false;
+        }
+        out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+        stream.avail_in = static_cast<uInt>(in.size());
+        stream.next_out = reinterpret_cast<Bytef *>(&out[0]);
+        stream.avail_out = static_cast<uInt>(out.size());
+        int result = deflate(&stream, Z_FINISH);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return result == Z_STREAM_END;
+    }
+#endif
+#ifdef DROIDMANIAC_WITH_BROTLI
+    case StaticAsset::ENCODING_BROTLI:
+    {
+        size_t size = BrotliEncoderMaxCompressedSize(in.size());
+        out.resize(size);
+        if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                                   in.size(), reinterpret_cast<const uint8_t *>(in.data()),
+                                   &size, reinterpret_cast<uint8_t *>(&out[0])))
+        {
+            return false;
+        }
+        out.resize(size);
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+StaticAsset::Encoding StaticAsset::select(int accepted) const
+{
+    if ((accepted & (1 << ENCODING_BROTLI)) && !m_body[ENCODING_BROTLI].empty())
+    {
+        return ENCODING_BROTLI;
+    }
+    if ((accepted & (1 << ENCODING_GZIP)) && !m_body[ENCODING_GZIP].empty())
+    {
+        return ENCODING_GZIP;
+    }
+    return ENCODING_IDENTITY;
+}
+
+bool StaticAsset::not_modified(Encoding encoding, std::string_view if_none_match) const
+{
+    // If-None-Match uses weak comparison, so a W/ prefix is ignored
+    while (!if_none_match.empty())
+    {
+        size_t end = if_none_match.find(',');
+        std::string_view tag = if_none_match.substr(0, end);
+        if_none_match = end == std::string_view::npos ? std::string_view() : if_none_match.substr(end + 1);
+
+        while (!tag.empty() && tag.front() == ' ')
+        {
+            tag.remove_prefix(1);
+        }
+        while (!tag.empty() && tag.back() == ' ')
+        {
+            tag.remove_suffix(1);
+        }
+        if (tag.substr(0, 2) == "W/")
+        {
+            tag.remove_prefix(2);
+        }
+
+        if (tag == "*" || tag == m_etag[encoding])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Everything is built into separate strings first and copied into the arena
+// in one go, so views into it never move
+struct AssetPiece
+{
+    std::string m_url;
+    std::filesystem::file_time_type m_modified;
+    uintmax_t m_file_size;
+    uint64_t m_hash;
+    int m_body_of; // Piece whose bodies this one serves, -1 for its own
+    std::string m_head[StaticAsset::ENCODING_COUNT];
+    std::string m_not_modified_head[StaticAsset::ENCODING_COUNT];
+    std::string m_body[StaticAsset::ENCODING_COUNT];
+    std::string m_etag[StaticAsset::ENCODING_COUNT];
+
+    size_t size() const
+    {
+        size_t size = m_url.size();
+        for (int encoding = 0; encoding < StaticAsset::ENCODING_COUNT; encoding++)
+        {
+            size += m_head[encoding].size() + m_not_modified_head[encoding].size() + m_body[encoding].size() + m_etag[encoding].size();
+        }
+        return size;
+    }
+};
+
+// Fills in the headers for every encoding content has a body for
+static void make_headers(AssetPiece &piece, const AssetPiece &content, const FileType &type, const char *cache_control)
+{
+    for (int encoding = 0; encoding < StaticAsset::ENCODING_COUNT; encoding++)
+    {
+        if (encoding != StaticAsset::ENCODING_IDENTITY && content.m_body[encoding].empty())
+        {
+            continue;
+        }
+
+        // Each encoding is a different byte sequence, so it gets its own strong ETag
+        piece.m_etag[encoding] = fmt::format("\"{:016x}{}\"", content.m_hash, ETAG_SUFFIXES[encoding]);
+
+        std::string validators = fmt::format("ETag: {}\r\n"
+                                             "Cache-Control: {}\r\n"
+                                             "Vary: Accept-Encoding",
+                                             piece.m_etag[encoding],
+                                             cache_control);
+        piece.m_not_modified_head[encoding] = "304 Not Modified\r\n" + validators;
+        piece.m_head[encoding] = fmt::format("200 OK\r\nContent-Type: {}\r\n{}", type.m_content_type, validators);
+        if (encoding != StaticAsset::ENCODING_IDENTITY)
+        {
+            piece.m_head[encoding] += fmt::format("\r\nContent-Encoding: {}", ENCODING_NAMES[encoding]);
+        }
+    }
+}
+
+static void make_bodies(AssetPiece &piece, std::string data, const EmbeddedAsset *embedded)
+{
+    for (int encoding = StaticAsset::ENCODING_GZIP; encoding < StaticAsset::ENCODING_COUNT; encoding++)
+    {
+        std::string compressed;
+        if (encoding == StaticAsset::ENCODING_GZIP && embedded && embedded->m_gzip_size)
+        {
+            // Compressed at build time
+            compressed.assign(reinterpret_cast<const char *>(embedded->m_gzip), embedded->m_gzip_size);
+        }
+        else if (!compress(static_cast<StaticAsset::Encoding>(encoding), data, compressed))
+        {
+            continue;
+        }
+
+        if (compressed.size() < data.size())
+        {
+            piece.m_body[encoding] = std::move(compressed);
+        }
+    }
+    piece.m_hash = fnv1a(data);
+    piece.m_body[StaticAsset::ENCODING_IDENTITY] = std::move(data);
+}
+
+// "/skins/a.css" becomes "/skins/a.0123abcd.css"
+static std::string hashed_url(const std::string &url, uint64_t hash)
+{
+    size_t name = url.rfind('/') + 1;
+    size_t extension = url.rfind('.');
+    if (extension == std::string::npos || extension <= name)
+    {
+        extension = url.size();
+    }
+    return fmt::format("{}.{:08x}{}", url.substr(0, extension), static_cast<uint32_t>(hash >> 32), url.substr(extension));
+}
+
+// Points quoted links in a page at the content-hashed URLs, both absolute
+// ("/app.js") and relative to the page ("app.js")
+static std::string link_hashed_urls(std::string html, const std::string &page_url, const std::vector<std::pair<std::string, std::string>> &renames)
+{
+    std::string directory = page_url.substr(0, page_url.rfind('/') + 1);
+    for (auto &[url, hashed] : renames)
+    {
+        for (char quote : {'"', '\''})
+        {
+            std::string from[] = {quote + url + quote, std::string()};
+            std::string to[] = {quote + hashed + quote, std::string()};
+            if (url.compare(0, directory.size(), directory) == 0)
+            {
+                from[1] = quote + url.substr(directory.size()) + quote;
+                to[1] = quote + hashed.substr(directory.size()) + quote;
+            }
+
+            for (int i = 0; i < 2 && !from[i].empty(); i++)
+            {
+                for (size_t at = html.find(from[i]); at != std::string::npos; at = html.find(from[i], at + to[i].size()))
+                {
+                    html.replace(at, from[i].size(), to[i]);
+                }
+            }
+        }
+    }
+    return html;
+}
+
+StaticAssets::StaticAssets() : m_arena(),
+                               m_assets(),
+                               m_table(),
+                               m_reloaded(0),
+                               m_overridden(0) {}
+
+bool StaticAssets::load(const std::string &root, const StaticAssets *previous)
+{
+    // Built in files first, then anything under root replaces or adds to them
+    struct Source
+    {
+        std::filesystem::path m_path; // Empty for built in files
+        const EmbeddedAsset *m_embedded;
+        std::filesystem::file_time_type m_modified;
+        uintmax_t m_file_size;
+    };
+    std::map<std::string, Source> sources;
+
+    for (size_t i = 0; i < EMBEDDED_ASSET_COUNT; i++)
+    {
+        const EmbeddedAsset &embedded = EMBEDDED_ASSETS[i];
+        sources[embedded.m_url] = Source{std::filesystem::path(), &embedded, std::filesystem::file_time_type::min(), embedded.m_size};
+    }
+
+    std::error_code error;
+    m_overridden = 0;
+    if (std::filesystem::is_directory(root, error))
+    {
+        for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+        {
+            // Files that vanish mid-scan (editors saving through a rename) are skipped
+            const std::filesystem::directory_entry &entry = *it;
+            std::error_code file_error;
+            if (!entry.is_regular_file(file_error))
+            {
+                continue;
+            }
+
+            Source source{entry.path(), nullptr, entry.last_write_time(file_error), entry.file_size(file_error)};
+            if (file_error)
+            {
+                continue;
+            }
+            sources["/" + std::filesystem::relative(entry.path(), root).generic_string()] = source;
+            m_overridden++;
+        }
+
+        if (error)
+        {
+            spdlog::error("Cannot load web assets from {}: {}", root, error.message());
+            return false;
+        }
+    }
+
+    // Pages go last, they link to the content-hashed URLs of everything else
+    std::vector<AssetPiece> pieces;
+    std::vector<std::pair<std::string, std::string>> renames;
+    for (bool pages : {false, true})
+    {
+        for (auto &[url, source] : sources)
+        {
+            const FileType &type = file_type(std::filesystem::path(url));
+            if ((type.m_content_type == HTML_CONTENT_TYPE) != pages)
+            {
+                continue;
+            }
+
+            AssetPiece piece;
+            piece.m_url = url;
+            piece.m_modified = source.m_modified;
+            piece.m_file_size = source.m_file_size;
+            piece.m_body_of = -1;
+
+            const StaticAsset *old = previous ? previous->find(piece.m_url) : nullptr;
+            bool changed = !old || old->m_modified != piece.m_modified || old->m_file_size != piece.m_file_size;
+
+            // Unchanged files are copied over from the last load, skipping the
+            // compression. Pages are always rebuilt as their links may have changed.
+            if (!changed && !pages)
+            {
+                piece.m_hash = old->m_hash;
+                for (int encoding = 0; encoding < StaticAsset::ENCODING_COUNT; encoding++)
+                {
+                    piece.m_head[encoding] = old->m_head[encoding];
+                    piece.m_not_modified_head[encoding] = old->m_not_modified_head[encoding];
+                    piece.m_body[encoding] = old->m_body[encoding];
+                    piece.m_etag[encoding] = old->m_etag[encoding];
+                }
+            }
+            else
+            {
+                std::string data;
+                if (source.m_embedded)
+                {
+                    data.assign(reinterpret_cast<const char *>(source.m_embedded->m_data), source.m_embedded->m_size);
+                }
+                else
+                {
+                    std::ifstream file(source.m_path, std::ios::binary);
+                    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                    if (!file.good() && !file.eof())
+                    {
+                        spdlog::error("Cannot read {}", source.m_path.string());
+                        return false;
+                    }
+                }
+
+                // A rewritten page no longer matches the build time gzip copy
+                if (pages)
+                {
+                    data = link_hashed_urls(std::move(data), url, renames);
+                }
+                make_bodies(piece, std::move(data), pages ? nullptr : source.m_embedded);
+                make_headers(piece, piece, type, type.m_cache_control);
+                m_reloaded += changed;
+            }
+
+            // The service worker has to stay at a fixed URL
+            if (!pages && url != SERVICE_WORKER_URL)
+            {
+                renames.emplace_back(url, hashed_url(url, piece.m_hash));
+            }
+            pieces.push_back(std::move(piece));
+        }
+    }
+
+    // Content-hashed URLs never change what they serve, so browsers may keep
+    // them forever without asking. They share the bodies of the plain URL.
+    size_t files = pieces.size();
+    for (size_t i = 0; i < files; i++)
+    {
+        auto rename = std::find_if(renames.begin(), renames.end(), [&](auto &r) { return r.first == pieces[i].m_url; });
+        if (rename == renames.end())
+        {
+            continue;
+        }
+
+        AssetPiece alias;
+        alias.m_url = rename->second;
+        alias.m_modified = pieces[i].m_modified;
+        alias.m_file_size = pieces[i].m_file_size;
+        alias.m_hash = pieces[i].m_hash;
+        alias.m_body_of = static_cast<int>(i);
+        make_headers(alias, pieces[i], file_type(std::filesystem::path(pieces[i].m_url)), IMMUTABLE_CACHE_CONTROL);
+        pieces.push_back(std::move(alias));
+    }
+
+    size_t arena_size = 0;
+    for (const AssetPiece &piece : pieces)
+    {
+        arena_size += piece.size();
+    }
+    m_arena.reserve(arena_size);
+    auto store = [this](const std::string &data) {
+        size_t offset = m_arena.size();
+        m_arena += data;
+        return std::string_view(m_arena.data() + offset, data.size());
+    };
+
+    m_assets.reserve(pieces.size());
+    for (AssetPiece &piece : pieces)
+    {
+        StaticAsset asset;
+        asset.m_url = store(piece.m_url);
+        asset.m_modified = piece.m_modified;
+        asset.m_file_size = piece.m_file_size;
+        asset.m_hash = piece.m_hash;
+        for (int encoding = 0; encoding < StaticAsset::ENCODING_COUNT; encoding++)
+        {
+            if (piece.m_head[encoding].empty())
+            {
+                continue;
+            }
+            asset.m_head[encoding] = store(piece.m_head[encoding]);
+            asset.m_not_modified_head[encoding] = store(piece.m_not_modified_head[encoding]);
+            asset.m_body[encoding] = piece.m_body_of < 0 ? store(piece.m_body[encoding]) : m_assets[piece.m_body_of].m_body[encoding];
+            asset.m_etag[encoding] = store(piece.m_etag[encoding]);
+        }
+
+        SPDLOG_DEBUG("Loaded {} ({} bytes, gzip {}, brotli {})",
+                     asset.m_url,
+                     asset.m_body[StaticAsset::ENCODING_IDENTITY].size(),
+                     asset.m_body[StaticAsset::ENCODING_GZIP].size(),
+                     asset.m_body[StaticAsset::ENCODING_BROTLI].size());
+        m_assets.push_back(asset);
+    }
+
+    // At most half full keeps probe sequences short. Directory index pages are
+    // also reachable as their directory, sharing the URL bytes.
+    size_t table_size = 8;
+    while (table_size < m_assets.size() * 4)
+    {
+        table_size *= 2;
+    }
+    m_table.assign(table_size, Slot{std::string_view(), 0});
+
+    const std::string_view index = "index.html";
+    for (uint32_t i = 0; i < m_assets.size(); i++)
+    {
+        std::string_view url = m_assets[i].m_url;
+        insert(url, i);
+        if (url.size() > index.size() && url.substr(url.size() - index.size()) == index && url[url.size() - index.size() - 1] == '/')
+        {
+            insert(url.substr(0, url.size() - index.size()), i);
+        }
+    }
+    return true;
+}
+
+void StaticAssets::insert(std::string_view url, uint32_t asset)
+{
+    size_t mask = m_table.size() - 1;
+    size_t i = fnv1a(url) & mask;
+    while (!m_table[i].m_url.empty())
+    {
+        i = (i + 1) & mask;
+    }
+    m_table[i] = Slot{url, asset};
+}
+
+const StaticAsset *StaticAssets::find(std::string_view url) const
+{
+    if (m_table.empty())
+    {
+        return nullptr;
+    }
+
+    size_t mask = m_table.size() - 1;
+    for (size_t i = fnv1a(url) & mask; !m_table[i].m_url.empty(); i = (i + 1) & mask)
+    {
+        if (m_table[i].m_url == url)
+        {
+            return &m_assets[m_table[i].m_asset];
+        }
+    }
+    return nullptr;
+}
+
+size_t StaticAssets::size() const
+{
+    return m_arena.size();
+}
+
+int StaticAssets::accepted_encodings(std::string_view accept_encoding)
+{
+    int accepted = 1 << StaticAsset::ENCODING_IDENTITY;
+
+    while (!accept_encoding.empty())
+    {
+        size_t end = accept_encoding.find(',');
+        std::string_view item = accept_encoding.substr(0, end);
+        accept_encoding = end == std::string_view::npos ? std::string_view() : accept_encoding.substr(end + 1);
+
+        size_t parameters = item.find(';');
+        std::string_view coding = item.substr(0, parameters);
+        while (!coding.empty() && coding.front() == ' ')
+        {
+            coding.remove_prefix(1);
+        }
+        while (!coding.empty() && coding.back() == ' ')
+        {
+            coding.remove_suffix(1);
+        }
+
+        // Only an explicit q=0 turns a coding off
+        if (parameters != std::string_view::npos)
+        {
+            std::string_view q = item.substr(parameters + 1);
+            while (!q.empty() && q.front() == ' ')
+            {
+                q.remove_prefix(1);
+            }
+            if (q.substr(0, 2) == "q=" && q.find_first_not_of("0.", 2) == std::string_view::npos)
+            {
+                continue;
+            }
+        }
+
+        for (int encoding = StaticAsset::ENCODING_GZIP; encoding < StaticAsset::ENCODING_COUNT; encoding++)
+        {
+            if (coding == ENCODING_NAMES[encoding])
+            {
+                accepted |= 1 << encoding;
+            }
+        }
+    }
+    return accepted;
+}
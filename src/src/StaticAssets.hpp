@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A file under res/www, ready to send in every encoding we have for it
+struct StaticAsset
+{
+    enum Encoding
+    {
+        ENCODING_IDENTITY,
+        ENCODING_GZIP,
+        ENCODING_BROTLI,
+        ENCODING_COUNT,
+    };
+
+    std::string_view m_url;
+
+    // Status line and headers, without the blank line, for writeStatus
+    std::string_view m_head[ENCODING_COUNT];
+    std::string_view m_not_modified_head[ENCODING_COUNT];
+    // Empty when that encoding did not make the file smaller
+    std::string_view m_body[ENCODING_COUNT];
+    // Quoted, as sent
+    std::string_view m_etag[ENCODING_COUNT];
+
+    // To tell which files a reload can reuse
+    std::filesystem::file_time_type m_modified;
+    uintmax_t m_file_size;
+    uint64_t m_hash; // Of the uncompressed content
+
+    // Best encoding out of a mask of (1 << ENCODING_...) bits
+    Encoding select(int accepted) const;
+
+    // Whether an If-None-Match request header lets us answer 304
+    bool not_modified(Encoding encoding, std::string_view if_none_match) const;
+};
+
+// Loads the assets built into the executable, overridden file by file by a
+// directory on disk, once into a single arena. Every file except pages and the
+// service worker is also served immutable under a content-hashed URL, which
+// pages are rewritten to link to. Lookups and responses are served
+// from memory without touching the disk or allocating. A loaded set is never
+// modified, reloading builds a new one to swap in.
+struct StaticAssets
+{
+    struct Slot
+    {
+        std::string_view m_url; // Empty if unused
+        uint32_t m_asset;
+    };
+
+    std::string m_arena;
+    std::vector<StaticAsset> m_assets; // Files by URL, then their content-hashed URLs
+    std::vector<Slot> m_table;         // Open addressed, power of two sized
+    int m_reloaded;                    // Files rebuilt rather than reused
+    int m_overridden;                  // Files taken from disk instead of the built in copy
+
+    StaticAssets();
+
+    // A missing root is fine, the built in assets are used as they are.
+    // Reuses entries of previous whose file has not changed since.
+    bool load(const std::string &root, const StaticAssets *previous = nullptr);
+
+    StaticAssets(const StaticAssets &) = delete;
+    StaticAssets &operator=(const StaticAssets &) = delete;
+
+    // Directory URLs ending in "/" find their index.html, nullptr if unknown
+    const StaticAsset *find(std::string_view url) const;
+
+    size_t size() const;
+
+    // Encoding mask from an Accept-Encoding request header
+    static int accepted_encodings(std::string_view accept_encoding);
+
+private:
+    void insert(std::string_view url, uint32_t asset);
+};
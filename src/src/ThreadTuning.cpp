@@ -0,0 +1,229 @@
+#include "ThreadTuning.hpp"
+
+#include "spdlog/spdlog.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+ThreadTuning::ThreadTuning() : m_cpus(),
+                               m_priority(PRIORITY_NORMAL) {}
+
+bool parse_cpu_list(const std::string &text, std::vector<int> &cpus)
+{
+    cpus.clear();
+
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        std::string item = text.substr(start, end - start);
+
+        int first, last;
+        char trailing;
+        if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &trailing) == 2)
+        {
+        }
+        else if (sscanf(item.c_str(), "%d%c", &first, &trailing) == 1)
+        {
+            last = first;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (first < 0 || last < first || 1023 < last)
+        {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+
+        start = end + 1;
+    }
+    return !cpus.empty();
+}
+
+static std::string format_cpu_list(const std::vector<int> &cpus)
+{
+    std::string text;
+    for (int cpu : cpus)
+    {
+        text += (text.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return text.empty() ? "none" : text;
+}
+
+#ifdef _WIN32
+
+void apply_thread_tuning(const char *name, const ThreadTuning &tuning)
+{
+    HANDLE thread = GetCurrentThread();
+
+    if (!tuning.m_cpus.empty())
+    {
+        DWORD_PTR mask = 0;
+        for (int cpu : tuning.m_cpus)
+        {
+            if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+            {
+                mask |= static_cast<DWORD_PTR>(1) << cpu;
+            }
+        }
+        if (!mask || !SetThreadAffinityMask(thread, mask))
+        {
+            spdlog::warn("Cannot pin {} thread to CPUs {} (error {})", name, format_cpu_list(tuning.m_cpus), GetLastError());
+        }
+    }
+
+    if (tuning.m_priority == ThreadTuning::PRIORITY_REALTIME)
+    {
+        if (SetThreadPriority(thread, THREAD_PRIORITY_TIME_CRITICAL))
+        {
+            return;
+        }
+        spdlog::warn("Cannot make {} thread time critical (error {}), trying high priority", name, GetLastError());
+    }
+
+    if (tuning.m_priority != ThreadTuning::PRIORITY_NORMAL && !SetThreadPriority(thread, THREAD_PRIORITY_HIGHEST))
+    {
+        spdlog::warn("Cannot raise {} thread priority (error {})", name, GetLastError());
+    }
+}
+
+void log_thread_stats(const char *name)
+{
+    DWORD_PTR process_mask, system_mask;
+    GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+
+    // Reading the thread's mask means setting it, so set it to what it already is
+    HANDLE thread = GetCurrentThread();
+    DWORD_PTR thread_mask = SetThreadAffinityMask(thread, process_mask);
+    if (thread_mask)
+    {
+        SetThreadAffinityMask(thread, thread_mask);
+    }
+
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); cpu++)
+    {
+        if (thread_mask & (static_cast<DWORD_PTR>(1) << cpu))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    // Windows has no public per-thread context switch counter
+    spdlog::info("{} thread: CPUs {}, priority {}", name, format_cpu_list(cpus), GetThreadPriority(thread));
+}
+
+#elif defined(__linux__)
+
+void apply_thread_tuning(const char *name, const ThreadTuning &tuning)
+{
+    if (!tuning.m_cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : tuning.m_cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (error)
+        {
+            spdlog::warn("Cannot pin {} thread to CPUs {} ({})", name, format_cpu_list(tuning.m_cpus), std::strerror(error));
+        }
+    }
+
+    if (tuning.m_priority == ThreadTuning::PRIORITY_REALTIME)
+    {
+        sched_param param;
+        param.sched_priority = 50;
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (!error)
+        {
+            return;
+        }
+        spdlog::warn("Cannot switch {} thread to SCHED_FIFO ({}), trying high priority", name, std::strerror(error));
+    }
+
+    if (tuning.m_priority != ThreadTuning::PRIORITY_NORMAL)
+    {
+        // On Linux nice values are per thread
+        pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, tid, -10) != 0)
+        {
+            spdlog::warn("Cannot raise {} thread priority ({})", name, std::strerror(errno));
+        }
+    }
+}
+
+void log_thread_stats(const char *name)
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+
+    int policy;
+    sched_param param;
+    pthread_getschedparam(pthread_self(), &policy, &param);
+
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+
+    spdlog::info("{} thread: CPUs {}, {}, {} voluntary and {} involuntary context switches",
+                 name,
+                 format_cpu_list(cpus),
+                 policy == SCHED_FIFO ? "SCHED_FIFO " + std::to_string(param.sched_priority) : "nice " + std::to_string(getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)))),
+                 usage.ru_nvcsw,
+                 usage.ru_nivcsw);
+}
+
+#else
+
+void apply_thread_tuning(const char *name, const ThreadTuning &tuning)
+{
+    if (!tuning.m_cpus.empty())
+    {
+        spdlog::warn("Cannot pin {} thread to CPUs {}, not supported on this platform", name, format_cpu_list(tuning.m_cpus));
+    }
+    if (tuning.m_priority != ThreadTuning::PRIORITY_NORMAL)
+    {
+        spdlog::warn("Cannot raise {} thread priority, not supported on this platform", name);
+    }
+}
+
+void log_thread_stats(const char *name)
+{
+    // Neither the affinity nor per-thread context switch counts are available here
+    spdlog::info("{} thread: no scheduling statistics on this platform", name);
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU affinity and scheduling priority for one of our threads
+struct ThreadTuning
+{
+    enum Priority
+    {
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,     // Raised priority within the normal scheduler
+        PRIORITY_REALTIME, // SCHED_FIFO on Linux, time critical on Windows
+    };
+
+    std::vector<int> m_cpus; // Empty to leave the affinity alone
+    Priority m_priority;
+
+    ThreadTuning();
+};
+
+// Parses "2", "0,2" or "2-3", returns false on malformed input
+bool parse_cpu_list(const std::string &text, std::vector<int> &cpus);
+
+// Applies to the calling thread. Anything the OS refuses (usually for lack of
+// privileges) is logged and skipped, falling back to the next best priority.
+void apply_thread_tuning(const char *name, const ThreadTuning &tuning);
+
+// Logs the calling thread's actual affinity and context switches so far
+void log_thread_stats(const char *name);
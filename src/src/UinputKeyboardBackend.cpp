@@ -0,0 +1,222 @@
+#ifdef __linux__
+
+#include "KeyboardBackend.hpp"
+
+#include "spdlog/spdlog.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/uinput.h>
+
+// https://www.kernel.org/doc/html/latest/input/uinput.html
+
+// Room for one SYN_REPORT per key event in the worst case
+static constexpr int INPUT_BUFFER_SIZE = 128;
+
+struct ExtendedKeyCode
+{
+    uint16_t m_scan_code;
+    int m_code;
+};
+
+// Without the 0xE0 prefix a scan code is its evdev key code already
+static const ExtendedKeyCode EXTENDED_KEY_CODES[] = {
+    {0xE01C, KEY_KPENTER}, {0xE01D, KEY_RIGHTCTRL}, {0xE035, KEY_KPSLASH}, {0xE038, KEY_RIGHTALT},
+    {0xE047, KEY_HOME}, {0xE048, KEY_UP}, {0xE049, KEY_PAGEUP}, {0xE04B, KEY_LEFT},
+    {0xE04D, KEY_RIGHT}, {0xE04F, KEY_END}, {0xE050, KEY_DOWN}, {0xE051, KEY_PAGEDOWN},
+    {0xE052, KEY_INSERT}, {0xE053, KEY_DELETE},
+};
+
+static int key_code(uint16_t scan_code)
+{
+    if (!(scan_code & SCAN_CODE_EXTENDED))
+    {
+        return scan_code;
+    }
+    for (const ExtendedKeyCode &code : EXTENDED_KEY_CODES)
+    {
+        if (code.m_scan_code == scan_code)
+        {
+            return code.m_code;
+        }
+    }
+    return KEY_RESERVED;
+}
+
+struct UinputKeyboardBackend : KeyboardBackend
+{
+    // evdev key code per lane
+    int m_layout[64];
+    int m_lanes;
+    int m_fd;
+
+    input_event m_input_buffer[INPUT_BUFFER_SIZE];
+    int m_buffered_events;
+
+    // Keys with an event in the current report, a second event for one of them starts a new report
+    uint64_t m_report_keys;
+
+    UinputKeyboardBackend();
+    ~UinputKeyboardBackend();
+
+    bool set_layout(const KeyboardLayout &layout);
+    bool open_device();
+
+    int lanes() const override;
+
+    void key_down(int i) override;
+    void key_up(int i) override;
+    void flush() override;
+
+private:
+    void push_event(uint16_t type, uint16_t code, int32_t value);
+    void push_key(int i, int32_t value);
+};
+
+UinputKeyboardBackend::UinputKeyboardBackend()
+    : m_layout(),
+      m_lanes(0),
+      m_fd(-1),
+      m_input_buffer(),
+      m_buffered_events(0),
+      m_report_keys(0)
+{
+}
+
+UinputKeyboardBackend::~UinputKeyboardBackend()
+{
+    if (m_fd >= 0)
+    {
+        ioctl(m_fd, UI_DEV_DESTROY);
+        close(m_fd);
+    }
+}
+
+bool UinputKeyboardBackend::set_layout(const KeyboardLayout &layout)
+{
+    m_lanes = layout.lanes();
+    for (int i = 0; i < m_lanes; i++)
+    {
+        m_layout[i] = key_code(layout.m_keys[i]);
+        if (m_layout[i] == KEY_RESERVED)
+        {
+            spdlog::error("Layout {} uses key {}, which has no uinput key code", layout.m_name, key_name(layout.m_keys[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UinputKeyboardBackend::open_device()
+{
+    m_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (m_fd < 0)
+    {
+        spdlog::error("Cannot open /dev/uinput ({}), check that the uinput module is loaded and you have write access", std::strerror(errno));
+        return false;
+    }
+
+    ioctl(m_fd, UI_SET_EVBIT, EV_KEY);
+    ioctl(m_fd, UI_SET_EVBIT, EV_SYN);
+    for (int i = 0; i < m_lanes; i++)
+    {
+        ioctl(m_fd, UI_SET_KEYBIT, m_layout[i]);
+    }
+
+    uinput_setup setup;
+    std::memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x1116;
+    setup.id.product = 0x0001;
+    std::strncpy(setup.name, "droidManiac virtual keyboard", UINPUT_MAX_NAME_SIZE - 1);
+
+    if (ioctl(m_fd, UI_DEV_SETUP, &setup) < 0 || ioctl(m_fd, UI_DEV_CREATE) < 0)
+    {
+        spdlog::error("Cannot create uinput keyboard ({})", std::strerror(errno));
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+int UinputKeyboardBackend::lanes() const
+{
+    return m_lanes;
+}
+
+void UinputKeyboardBackend::push_event(uint16_t type, uint16_t code, int32_t value)
+{
+    input_event &event = m_input_buffer[m_buffered_events++];
+    event.type = type;
+    event.code = code;
+    event.value = value;
+}
+
+void UinputKeyboardBackend::push_key(int i, int32_t value)
+{
+    // Leave room for a separating SYN_REPORT, this key event and the SYN_REPORT closing the batch
+    if (m_buffered_events + 3 > INPUT_BUFFER_SIZE)
+    {
+        flush();
+    }
+
+    uint64_t bit = 1ULL << i;
+    if (m_report_keys & bit)
+    {
+        // Press and release of one key must land in separate reports
+        push_event(EV_SYN, SYN_REPORT, 0);
+        m_report_keys = 0;
+    }
+    m_report_keys |= bit;
+
+    push_event(EV_KEY, static_cast<uint16_t>(m_layout[i]), value);
+}
+
+void UinputKeyboardBackend::key_down(int i)
+{
+    SPDLOG_DEBUG("{} Down", m_layout[i]);
+    push_key(i, 1);
+}
+
+void UinputKeyboardBackend::key_up(int i)
+{
+    SPDLOG_DEBUG("{} Up", m_layout[i]);
+    push_key(i, 0);
+}
+
+void UinputKeyboardBackend::flush()
+{
+    if (m_buffered_events == 0)
+    {
+        return;
+    }
+
+    push_event(EV_SYN, SYN_REPORT, 0);
+
+    // One write for the whole batch, the kernel timestamps each event on arrival
+    ssize_t size = m_buffered_events * sizeof(input_event);
+    if (write(m_fd, m_input_buffer, size) != size)
+    {
+        spdlog::warn("uinput write failed ({})", std::strerror(errno));
+    }
+
+    m_buffered_events = 0;
+    m_report_keys = 0;
+}
+
+std::unique_ptr<KeyboardBackend> create_uinput_backend(const KeyboardLayout &layout)
+{
+    auto backend = std::make_unique<UinputKeyboardBackend>();
+    if (!backend->set_layout(layout) || !backend->open_device())
+    {
+        return nullptr;
+    }
+    return backend;
+}
+
+#endif
@@ -1,6 +1,11 @@
 #include "Utils.hpp"
 
 #include <stdio.h>
+
+#include <filesystem>
+
+#ifdef _WIN32
+
 #include <WinSock.h>
 
 // https://www.codeguru.com/csharp/csharp/cs_network/article.php/c6045/Obtain-all-IP-addresses-of-local-machine.htm
@@ -38,3 +43,75 @@ std::vector<std::string> get_ip_addresses()
     }
     return ip_addresses;
 };
+
+#else
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+std::vector<std::string> get_ip_addresses()
+{
+    std::vector<std::string> ip_addresses;
+
+    struct ifaddrs *interfaces = nullptr;
+    if (getifaddrs(&interfaces) != 0)
+    {
+        return ip_addresses;
+    }
+
+    for (struct ifaddrs *it = interfaces; it != nullptr; it = it->ifa_next)
+    {
+        if (it->ifa_addr == nullptr || it->ifa_addr->sa_family != AF_INET || (it->ifa_flags & IFF_LOOPBACK))
+        {
+            continue;
+        }
+
+        char ip_address[INET_ADDRSTRLEN];
+        if (inet_ntop(AF_INET, &((struct sockaddr_in *)it->ifa_addr)->sin_addr, ip_address, sizeof(ip_address)))
+        {
+            ip_addresses.push_back(ip_address);
+        }
+    }
+
+    freeifaddrs(interfaces);
+    return ip_addresses;
+}
+
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#elif __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+std::string get_executable_directory()
+{
+    std::error_code error;
+    std::filesystem::path executable;
+#ifdef _WIN32
+    wchar_t path[MAX_PATH];
+    DWORD size = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    if (0 < size && size < MAX_PATH)
+    {
+        executable = std::filesystem::path(path, path + size);
+    }
+#elif __linux__
+    executable = std::filesystem::read_symlink("/proc/self/exe", error);
+#elif __APPLE__
+    char path[4096];
+    uint32_t size = sizeof(path);
+    if (_NSGetExecutablePath(path, &size) == 0)
+    {
+        executable = std::filesystem::canonical(path, error);
+    }
+#endif
+
+    if (executable.empty() || error)
+    {
+        return std::filesystem::current_path(error).string();
+    }
+    return executable.parent_path().string();
+}
@@ -4,3 +4,6 @@
 #include <string>
 
 std::vector<std::string> get_ip_addresses();
+
+// Absolute directory holding the running executable, the working directory if it cannot be found
+std::string get_executable_directory();
@@ -1,8 +1,19 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <thread>
+
 #include "optparse/optparse.hpp"
 #include "spdlog/spdlog.h"
 
 #include "BrokenithmServer.hpp"
+#include "Clock.hpp"
+#include "Injector.hpp"
 #include "KeyboardSimulator.hpp"
+#include "Logging.hpp"
+#include "Metrics.hpp"
+#include "SessionLog.hpp"
+#include "ThreadTuning.hpp"
 #include "Utils.hpp"
 
 #include "version.rc"
@@ -25,10 +36,35 @@ Running a hotspot from your windows machine also works. Make sure
 correct firewall access is granted.
 
 Built for use with osu!stable only (for now).
-Keyboard output is ADJL (left to right).
+Keyboard output is ADJL (left to right) by default, see --layout.
 
 Also check out brokenithm-kb at https://github.com/4yn/brokenithm-kb !)";
 
+static std::atomic_bool s_running(true);
+
+static void handle_signal(int)
+{
+    s_running = false;
+}
+
+static bool parse_thread_tuning(const std::string &cpus, const std::string &priority, ThreadTuning &tuning)
+{
+    if (!cpus.empty() && !parse_cpu_list(cpus, tuning.m_cpus))
+    {
+        return false;
+    }
+
+    if (priority == "high")
+    {
+        tuning.m_priority = ThreadTuning::PRIORITY_HIGH;
+    }
+    else if (priority == "realtime")
+    {
+        tuning.m_priority = ThreadTuning::PRIORITY_REALTIME;
+    }
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     optparse::OptionParser parser = optparse::OptionParser()
@@ -38,6 +74,28 @@ int main(int argc, char **argv)
 
     parser.add_option("-p", "--port").dest("port").type("int").set_default(1116).help("Port to listen on (1-65535)");
     parser.add_option("-f", "--frequency").dest("frequency").type("int").set_default(100).help("Polling frequency, samples per second (1-1000)");
+    const char *dispatch_modes[] = {"event", "poll", "scheduled"};
+    parser.add_option("-m", "--mode").dest("mode").choices(&dispatch_modes[0], &dispatch_modes[3]).set_default("event").help("Key dispatch mode, inject on every received frame (event), sample at the polling frequency (poll) or inject a fixed delay after each touch (scheduled)");
+    parser.add_option("--delay").dest("delay").type("int").set_default(30).help("Touch to keystroke delay in scheduled mode, milliseconds (1-1000)");
+    parser.add_option("-l", "--layout").dest("layout").set_default(keyboard_layouts().front().m_name).help("Keymap profile, the lanes and the keys they press, the controller page follows. Built in are 1k to 18k and slider, 1k to 10k use osu!mania's default bindings (ADJL for 4k), wider layouts the letter rows in order, slider is 16 slider cells and 6 air sensors");
+    parser.add_option("--keymap").dest("keymap").set_default("").help("Load more keymap profiles for --layout from this file");
+    const char *merge_policies[] = {"or", "lanes", "primary"};
+    parser.add_option("--merge").dest("merge").choices(&merge_policies[0], &merge_policies[3]).set_default("or").help("How to combine multiple controllers, hold a lane if any controller holds it (or), give each controller its own lanes (lanes) or only use the first connected controller (primary)");
+    parser.add_option("--device-lanes").dest("device_lanes").type("int").set_default(4).help("Lanes given to each controller in lanes merge mode (1-64)");
+    const char *const priorities[] = {"normal", "high", "realtime"};
+    parser.add_option("--server-cpus").dest("server_cpus").set_default("").help("CPUs to pin the network thread to, e.g. 2 or 2-3 (default any)");
+    parser.add_option("--injector-cpus").dest("injector_cpus").set_default("").help("CPUs to pin the key injection thread to, e.g. 1 (default any)");
+    parser.add_option("--server-priority").dest("server_priority").choices(&priorities[0], &priorities[3]).set_default("normal").help("Network thread priority, realtime needs root or CAP_SYS_NICE on Linux and falls back to high");
+    parser.add_option("--injector-priority").dest("injector_priority").choices(&priorities[0], &priorities[3]).set_default("normal").help("Key injection thread priority, realtime needs root or CAP_SYS_NICE on Linux and falls back to high");
+    parser.add_option("--low-latency").dest("low_latency").type("bool").set_default(false).action("store_true").help("Tune sockets for latency: busy polling, quick acks, small buffers and low delay TOS marking");
+    parser.add_option("--heartbeat").dest("heartbeat").type("int").set_default(0).help("Release a controller's lanes when its page has been silent this many milliseconds, e.g. 500 (default 0 waits for the WebSocket to time out, 0 or 20-5000)");
+    parser.add_option("--busy-poll").dest("busy_poll").type("bool").set_default(false).action("store_true").help("Spin the network thread instead of sleeping between events, burns one core, best with --server-cpus");
+    parser.add_option("--record").dest("record").set_default("").help("Append every message controllers send to this file, for --replay");
+    parser.add_option("--replay").dest("replay").set_default("").help("Play a --record file through the key injection instead of starting the server");
+    parser.add_option("--replay-speed").dest("replay_speed").type("double").set_default(1.0).help("Replay speed multiplier, 0 replays as fast as possible");
+    parser.add_option("-s", "--stats").dest("stats").type("int").set_default(0).help("Print dispatch latency statistics every N seconds (0 to disable)");
+    const std::vector<std::string> backends = keyboard_backend_names();
+    parser.add_option("-b", "--backend").dest("backend").choices(backends.begin(), backends.end()).set_default(backends.front()).help("Key injection backend, record keeps the latest million keystrokes in memory only");
     parser.add_option("-d", "--dry-run").dest("dryrun").type("bool").set_default(false).action("store_true").help("Run server but do not send any keystrokes");
     parser.add_option("-q", "--quiet").dest("quiet").type("bool").set_default(false).action("store_true").help("Do not print any output");
     parser.add_option("-v", "--verbose").dest("verbose").type("bool").set_default(false).action("store_true").help("Print verbose output");
@@ -58,10 +116,125 @@ int main(int argc, char **argv)
         spdlog::error("Invalid frequency {}", frequency);
         exit(1);
     }
-    int millis_delay = std::clamp(1000 / frequency, 1, 1000);
+
+    std::string mode = options["mode"];
+    Injector::DispatchMode dispatch_mode = Injector::DISPATCH_EVENT;
+    if (mode == "poll")
+    {
+        dispatch_mode = Injector::DISPATCH_POLL;
+    }
+    else if (mode == "scheduled")
+    {
+        dispatch_mode = Injector::DISPATCH_SCHEDULED;
+    }
+
+    int schedule_delay = static_cast<int>(options.get("delay"));
+    if (schedule_delay < 1 || 1000 < schedule_delay)
+    {
+        spdlog::error("Invalid delay {}", schedule_delay);
+        exit(1);
+    }
+
+    std::string merge = options["merge"];
+    ControllerState::MergePolicy merge_policy = ControllerState::MERGE_OR;
+    if (merge == "lanes")
+    {
+        merge_policy = ControllerState::MERGE_LANES;
+    }
+    else if (merge == "primary")
+    {
+        merge_policy = ControllerState::MERGE_PRIMARY;
+    }
+
+    int device_lanes = static_cast<int>(options.get("device_lanes"));
+    if (device_lanes < 1 || 64 < device_lanes)
+    {
+        spdlog::error("Invalid device lane count {}", device_lanes);
+        exit(1);
+    }
+
+    int stats_interval = static_cast<int>(options.get("stats"));
+    if (stats_interval < 0)
+    {
+        spdlog::error("Invalid stats interval {}", stats_interval);
+        exit(1);
+    }
+
+    ThreadTuning server_tuning;
+    ThreadTuning injector_tuning;
+    if (!parse_thread_tuning(options["server_cpus"], options["server_priority"], server_tuning))
+    {
+        spdlog::error("Invalid server CPU list {}", options["server_cpus"]);
+        exit(1);
+    }
+    if (!parse_thread_tuning(options["injector_cpus"], options["injector_priority"], injector_tuning))
+    {
+        spdlog::error("Invalid injector CPU list {}", options["injector_cpus"]);
+        exit(1);
+    }
+
+    int heartbeat_deadline = static_cast<int>(options.get("heartbeat"));
+    if (heartbeat_deadline != 0 && (heartbeat_deadline < 20 || 5000 < heartbeat_deadline))
+    {
+        spdlog::error("Invalid heartbeat deadline {}", heartbeat_deadline);
+        exit(1);
+    }
+
+    bool low_latency = static_cast<bool>(options.get("low_latency"));
+    bool busy_poll = static_cast<bool>(options.get("busy_poll"));
+
+    std::string record_path = options["record"];
+    std::string replay_path = options["replay"];
+    double replay_speed = static_cast<double>(options.get("replay_speed"));
+    if (!record_path.empty() && !replay_path.empty())
+    {
+        spdlog::error("Cannot record and replay at the same time");
+        exit(1);
+    }
+    if (replay_speed < 0)
+    {
+        spdlog::error("Invalid replay speed {}", replay_speed);
+        exit(1);
+    }
 
     bool dryrun = static_cast<bool>(options.get("dryrun"));
 
+    std::string keymap_path = options["keymap"];
+    if (!keymap_path.empty() && !load_keymap_file(keymap_path))
+    {
+        exit(1);
+    }
+    const KeyboardLayout *layout_profile = find_keyboard_layout(options["layout"]);
+    if (!layout_profile)
+    {
+        std::string names;
+        for (const KeyboardLayout &layout : keyboard_layouts())
+        {
+            names += ' ' + layout.m_name;
+        }
+        spdlog::error("Unknown layout {}, choose one of{}", options["layout"], names);
+        exit(1);
+    }
+    const KeyboardLayout &layout = *layout_profile;
+    // Controller n drives lanes [n * device_lanes, (n + 1) * device_lanes), those past the layout press nothing
+    if (merge_policy == ControllerState::MERGE_LANES)
+    {
+        if (layout.lanes() < 2 * device_lanes)
+        {
+            spdlog::error("Lanes merge mode with {} device lanes needs a layout of at least {} lanes for two controllers, {} has {}", device_lanes, 2 * device_lanes, layout.m_name, layout.lanes());
+            exit(1);
+        }
+        if (layout.lanes() % device_lanes != 0)
+        {
+            spdlog::warn("Layout {} has {} lanes, the last controller in lanes merge mode only gets {} of its {} device lanes", layout.m_name, layout.lanes(), layout.lanes() % device_lanes, device_lanes);
+        }
+    }
+    std::unique_ptr<KeyboardBackend> backend = create_keyboard_backend(dryrun ? "record" : options["backend"], layout);
+    if (!backend)
+    {
+        exit(1);
+    }
+
     std::vector<std::string> ip_addresses = get_ip_addresses();
     if (ip_addresses.size() == 0)
     {
@@ -76,6 +249,9 @@ int main(int argc, char **argv)
         spdlog::error("Cannot use quiet and verbose mode at the same time");
     }
 
+    // Before the network and injector threads start, so none of them ever blocks on a console write
+    use_async_logging();
+
     if (quiet)
     {
         spdlog::set_level(spdlog::level::off);
@@ -89,7 +265,7 @@ int main(int argc, char **argv)
         spdlog::set_level(spdlog::level::info);
     }
 
-    if (!quiet)
+    if (!quiet && replay_path.empty())
     {
         std::cout << banner << std::endl;
 
@@ -101,17 +277,138 @@ int main(int argc, char **argv)
         std::cout << std::flush;
     }
 
+    spdlog::info("Layout {}, {} lanes: {}", layout.m_name, layout.lanes(), layout.describe());
+
+    if (busy_poll && server_tuning.m_cpus.empty())
+    {
+        spdlog::warn("Busy polling without --server-cpus, the spinning network thread can land on any core");
+    }
+
+    SessionRecorder recorder;
+    if (!record_path.empty())
+    {
+        if (!recorder.open(record_path))
+        {
+            exit(1);
+        }
+        spdlog::info("Recording controller input to {}", record_path);
+    }
+
+    // A replay stands in for the server thread, the server itself is never started
     BrokenithmServer brokenithmServer(port);
-    brokenithmServer.start_server();
+    brokenithmServer.set_merge_policy(merge_policy, device_lanes);
+    brokenithmServer.set_layout(layout.lanes(), layout.m_air_lanes);
+    brokenithmServer.set_thread_tuning(server_tuning);
+    brokenithmServer.set_low_latency(low_latency, busy_poll);
+    brokenithmServer.set_heartbeat_deadline(heartbeat_deadline);
+    if (!record_path.empty())
+    {
+        brokenithmServer.set_recorder(&recorder);
+    }
 
-    KeyboardSimulator keyboardSimulator;
+    ReplayStats replay_stats;
+    bool replayed = false;
+    std::thread replay_thread;
+    bool started = true;
+    if (replay_path.empty())
+    {
+        // On failure skip straight to the usual shutdown, so the log and the recording are flushed
+        started = brokenithmServer.start_server();
+        s_running = started;
+    }
+    else
+    {
+        replay_thread = std::thread([&] {
+            apply_thread_tuning("Replay", server_tuning);
+            replayed = replay_session(replay_path, brokenithmServer.get_controller(), brokenithmServer.get_metrics(), replay_speed, s_running, replay_stats);
+            if (replayed)
+            {
+                // Scheduled dispatch holds the last edges back for the delay
+                std::this_thread::sleep_for(std::chrono::milliseconds(schedule_delay + 100));
+            }
+            s_running = false;
+        });
+    }
+
+    KeyboardSimulator keyboardSimulator(std::move(backend));
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
 
-    while (1)
+    Metrics &metrics = brokenithmServer.get_metrics();
+    int64_t next_stats_time = now_nanos() + stats_interval * 1000000000LL;
+
+    apply_thread_tuning("Injector", injector_tuning);
+    log_thread_stats("Injector");
+
+    Injector injector(brokenithmServer.get_controller(), keyboardSimulator, metrics, dispatch_mode, dryrun);
+    injector.set_poll_frequency(frequency);
+    injector.set_schedule_delay(schedule_delay);
+
+    while (s_running)
     {
-        keyboardSimulator.delay(millis_delay);
-        if (!dryrun)
+        injector.run_once();
+
+        if (stats_interval && now_nanos() >= next_stats_time)
         {
-            keyboardSimulator.send(brokenithmServer.get_controller_state());
+            spdlog::info("Receive to inject latency {}", metrics.m_receive_to_inject.summary());
+            next_stats_time += stats_interval * 1000000000LL;
         }
     }
+
+    if (replay_thread.joinable())
+    {
+        replay_thread.join();
+        spdlog::info("Replayed {} records, {:.3f} s of input, {} frames ({} no longer parse)",
+                     replay_stats.m_records,
+                     replay_stats.m_recorded_nanos / 1e9,
+                     replay_stats.m_frames,
+                     replay_stats.m_mismatched_frames);
+    }
+    else
+    {
+        brokenithmServer.stop_server();
+    }
+    if (!record_path.empty())
+    {
+        recorder.close();
+        spdlog::info("Recorded {} messages to {} ({} bytes, {} dropped)", recorder.records(), record_path, recorder.bytes_written(), recorder.dropped_records());
+    }
+    log_thread_stats("Injector");
+    spdlog::info("Receive to inject latency ({} mode) {}", mode, metrics.m_receive_to_inject.summary());
+    spdlog::info("Publish to inject latency ({} mode) {}", mode, metrics.m_publish_to_inject.summary());
+    if (metrics.m_touch_to_inject.count())
+    {
+        spdlog::info("Touch to inject latency ({} mode) {}", mode, metrics.m_touch_to_inject.summary());
+    }
+    if (dispatch_mode == Injector::DISPATCH_POLL)
+    {
+        spdlog::info("Polled at {:.1f} Hz (requested {} Hz) using {}, wakeup overshoot {}",
+                     injector.poll_rate(),
+                     frequency,
+                     injector.m_timer.method(),
+                     metrics.m_timer_overshoot.summary());
+    }
+    if (dispatch_mode == Injector::DISPATCH_SCHEDULED)
+    {
+        spdlog::info("Scheduled {} ms after touch, lateness {}, {} edges arrived late",
+                     schedule_delay,
+                     metrics.m_schedule_lateness.summary(),
+                     metrics.m_late_edges.load());
+        spdlog::info("Wakeup overshoot using {} {}", injector.m_timer.method(), metrics.m_timer_overshoot.summary());
+    }
+    if (metrics.m_heartbeat_detection.count())
+    {
+        spdlog::info("Controllers went silent {} times, {} forced releases, silence when noticed {}",
+                     metrics.m_heartbeat_detection.count(),
+                     metrics.m_forced_releases.load(),
+                     metrics.m_heartbeat_detection.summary());
+    }
+    spdlog::info("Injected {} key edges, {} would have been lost to state sampling at {} Hz, {} dropped on queue overflow",
+                 metrics.m_edges_injected.load(),
+                 metrics.m_edges_saved.load(),
+                 frequency,
+                 brokenithmServer.get_controller().m_dropped_edges.load());
+
+    return replay_path.empty() ? (started ? 0 : 1) : (replayed ? 0 : 1);
 }